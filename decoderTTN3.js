@@ -1,9 +1,135 @@
+// read given number of bits (MSB first) from byte array
+function readBits(bytes, state, bits) {
+    var value = 0;
+    for (var b = 0; b < bits; b++) {
+        var pos = state.pos++;
+        value = (value << 1) | ((bytes[pos >> 3] >> (7 - (pos & 7))) & 1);
+    }
+    return value;
+}
+
+// 10 bit PM code: 0.1 μg/m3 below 50 μg/m3, 2 μg/m3 above
+function decodePM(code) {
+    return code < 500 ? code / 10.0 : 50 + (code - 500) * 2;
+}
+
+// payload version 3/4: bit-packed fields, presence depends on sensor status,
+// version 4 adds an extension byte which flags optional trailing fields
+function DecoderPacked(bytes, decoded) {
+    var version = bytes[0];
+    var status = bytes[1];
+    var ext = version >= 4 ? bytes[2] : 0;
+    var vbat = bytes[version >= 4 ? 3 : 2];
+    var state = { pos: version >= 4 ? 32 : 24 };
+
+    if (vbat > 0)
+        decoded.battery = (vbat + 256) / 100.0;
+    if (status & 0xE0) { // BME280, SHT31 or SI7021
+        var temp = readBits(bytes, state, 11);
+        var hum = readBits(bytes, state, 7);
+        if (temp != 0x7FF)
+            decoded.temperature = (temp - 400) / 10.0;
+        if (hum != 0x7F)
+            decoded.humidity = hum;
+    }
+    if (status & 0x20) // BME280
+        decoded.pressure = readBits(bytes, state, 12) / 5.0 + 500;
+    if ((status & 0x10) == 0 && (ext & 0x02) == 0) { // no SDS011 error, not skipped
+        decoded.pm25 = decodePM(readBits(bytes, state, 10));
+        decoded.pm10 = decodePM(readBits(bytes, state, 10));
+    }
+    if (ext & 0x01) // observation interval (minutes)
+        decoded.interval = readBits(bytes, state, 8) * 60;
+    if (ext & 0x04) { // battery state of charge and power tier
+        decoded.soc = readBits(bytes, state, 7);
+        decoded.power = ["normal", "low", "critical", "hibernate"][readBits(bytes, state, 2)];
+    }
+    if (ext & 0x08) { // statistics of SDS011 readings
+        decoded.pm_samples = readBits(bytes, state, 8);
+        decoded.pm25_stats = { min: decodePM(readBits(bytes, state, 10)),
+            max: decodePM(readBits(bytes, state, 10)), stddev: decodePM(readBits(bytes, state, 10)) };
+        decoded.pm10_stats = { min: decodePM(readBits(bytes, state, 10)),
+            max: decodePM(readBits(bytes, state, 10)), stddev: decodePM(readBits(bytes, state, 10)) };
+    }
+    if (ext & 0x10) { // PM alert reasons
+        var alert = readBits(bytes, state, 3);
+        decoded.alert = ["pm25", "pm10", "rise"].filter(function(reason, i) { return alert & (1 << i); });
+    }
+    if (ext & 0x20) { // acknowledge of remote settings (port 5)
+        var ack = readBits(bytes, state, 8);
+        decoded.settings = { applied: (ack & 0x80) != 0, revision: ack & 0x7F };
+    }
+    return decoded;
+}
+
+// length of packed observation (without version byte) starting at bytes[i]
+function lengthPacked(version, bytes, i) {
+    var status = bytes[i];
+    var ext = version >= 4 ? bytes[i+1] : 0;
+    var bits = 0;
+    if (status & 0xE0)
+        bits += 18;
+    if (status & 0x20)
+        bits += 12;
+    if ((status & 0x10) == 0 && (ext & 0x02) == 0)
+        bits += 20;
+    if (ext & 0x01)
+        bits += 8;
+    if (ext & 0x04)
+        bits += 9;
+    if (ext & 0x08)
+        bits += 68;
+    if (ext & 0x10)
+        bits += 3;
+    if (ext & 0x20)
+        bits += 8;
+    return (version >= 4 ? 3 : 2) + Math.ceil(bits / 8);
+}
+
+// batch frame (port 2) or backlog from flash log (port 3): version byte followed
+// by observations, each with time offset (seconds before transmission, LEB128 varint)
+function DecoderBatch(bytes, decoded) {
+    var version = bytes[0];
+    decoded.observations = [];
+    for (var i = 1; i < bytes.length;) {
+        var offset = 0, shift = 0;
+        do {
+            offset += (bytes[i] & 0x7F) * Math.pow(2, shift);
+            shift += 7;
+        } while (bytes[i++] & 0x80);
+        var len = lengthPacked(version, bytes, i);
+        var observation = DecoderPacked([version].concat(bytes.slice(i, i + len)), { offset: offset });
+        decoded.observations.push(observation);
+        i += len;
+    }
+    return decoded;
+}
+
+// diagnostics report (port 4): version byte followed by counters accumulated
+// since firmware was flashed (LEB128 varints), see include/diag.h
+function DecoderDiag(bytes, decoded) {
+    var names = ["awake_ms", "standby_secs", "fan_ms", "tx_ms", "rx_ms",
+        "sds011_retries", "sds011_timeouts", "joins", "resets"];
+    decoded.diag_version = bytes[0];
+    for (var i = 1, n = 0; i < bytes.length && n < names.length; n++) {
+        var value = 0, shift = 0;
+        do {
+            value += (bytes[i] & 0x7F) * Math.pow(2, shift);
+            shift += 7;
+        } while (bytes[i++] & 0x80);
+        decoded[names[n]] = value;
+    }
+    return decoded;
+}
+
 function Decoder(bytes, fPort)  {
     var decoded = {};
 
     if (fPort == 1) {  
         payloadversion = bytes[0];
       	decoded.length = bytes.length;
+        if (payloadversion == 3 || payloadversion == 4)
+            return DecoderPacked(bytes, decoded);
   
         // byte0: payloadversion
         // byte1: sensor status
@@ -35,6 +161,11 @@ function Decoder(bytes, fPort)  {
                     break;
             }
         }
+    } else if ((fPort == 2 || fPort == 3) && (bytes[0] == 3 || bytes[0] == 4)) {
+        decoded.length = bytes.length;
+        return DecoderBatch(bytes, decoded);
+    } else if (fPort == 4 && bytes[0] == 1) {
+        return DecoderDiag(bytes, decoded);
     }
     return decoded;
 }
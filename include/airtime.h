@@ -0,0 +1,46 @@
+/***************************************************************************
+  Copyright (c) 2024 Lars Wessels
+
+  This file is part of the "Feather-M0-LoRaWAN-PM-Sensor" source code.
+  https://github.com/lrswss/feather-m0-lorawan-pm-sensor
+
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+   
+  http://www.apache.org/licenses/LICENSE-2.0
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+***************************************************************************/
+
+#ifndef _AIRTIME_H
+#define _AIRTIME_H
+
+#include <Arduino.h>
+
+// airtime limits in ms: EU868 duty cycle 1% (36 s per hour)
+// and TTN fair use policy (30 s per day)
+#define AIRTIME_HOURLY_MS 36000
+#define AIRTIME_DAILY_MS 30000
+
+// rolling totals: last hour in 5 minute buckets, last day in hourly buckets
+#define AIRTIME_HOUR_BUCKETS 12
+#define AIRTIME_DAY_BUCKETS 24
+
+// symbols for preamble detection in an empty receive window
+#define AIRTIME_RX_SYMBOLS 8
+
+uint32_t airtime_ms(uint8_t datarate, uint8_t len);
+uint32_t airtime_rx_ms(uint8_t datarate, uint32_t margin, uint8_t len);
+void airtime_add(uint32_t ms, uint32_t now);
+uint32_t airtime_hour(uint32_t now);
+uint32_t airtime_day(uint32_t now);
+bool airtime_available(uint32_t ms, uint32_t now);
+uint16_t airtime_interval(uint16_t secs, uint32_t now);
+
+#endif
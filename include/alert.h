@@ -0,0 +1,58 @@
+/***************************************************************************
+  Copyright (c) 2024 Lars Wessels
+
+  This file is part of the "Feather-M0-LoRaWAN-PM-Sensor" source code.
+  https://github.com/lrswss/feather-m0-lorawan-pm-sensor
+
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+   
+  http://www.apache.org/licenses/LICENSE-2.0
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+***************************************************************************/
+
+#ifndef _ALERT_H
+#define _ALERT_H
+
+#include <Arduino.h>
+#include "config.h"
+#include "sensors.h"
+
+// PM values (μg/m3) to enter alert state, state is left if PM values drop
+// below limit minus given hysteresis (% of limit)
+#define ALERT_PM25_LIMIT 25
+#define ALERT_PM10_LIMIT 50
+#define ALERT_HYSTERESIS_PCT 20
+
+// rapid rise of PM values compared to previous observation, at least
+// ALERT_RISE_PCT (%) and ALERT_RISE_MIN (μg/m3) to enter alert state
+#define ALERT_RISE_PCT 100
+#define ALERT_RISE_MIN 10
+
+// observation interval (secs) in alert state
+#define ALERT_INTERVAL_SECS 120
+
+// max. number of observations sent in alert state (short interval,
+// batch frame sent immediately) within given period (secs)
+#define ALERT_BUDGET 24
+#define ALERT_BUDGET_SECS 86400
+
+enum alertReason {
+    ALERT_NONE = 0x00,
+    ALERT_PM25 = 0x01,  // PM2.5 above ALERT_PM25_LIMIT
+    ALERT_PM10 = 0x02,  // PM10 above ALERT_PM10_LIMIT
+    ALERT_RISE = 0x04   // rapid rise of PM values
+};
+
+uint8_t alert_update(sensorReadings_t *readings, uint32_t now);
+bool alert_active();
+uint16_t alert_interval(uint16_t secs);
+
+#endif
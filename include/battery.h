@@ -0,0 +1,68 @@
+/***************************************************************************
+  Copyright (c) 2024 Lars Wessels
+
+  This file is part of the "Feather-M0-LoRaWAN-PM-Sensor" source code.
+  https://github.com/lrswss/feather-m0-lorawan-pm-sensor
+
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+   
+  http://www.apache.org/licenses/LICENSE-2.0
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+***************************************************************************/
+
+#ifndef _BATTERY_H
+#define _BATTERY_H
+
+#include <Arduino.h>
+#include "config.h"
+
+// set according to values of voltage divider on VBAT_PIN
+#define VBAT_MULTIPLIER 2
+#define VBAT_MAX_MV 4210  // above: charging or running on USB power
+#define VBAT_MIN_MV 2550  // below: no battery connected
+
+// each measurement averages BATTERY_SAMPLES 12-bit ADC samples (without min/max)
+// and is smoothed with previous measurements (weight 1/BATTERY_FILTER) unless
+// voltage changed by more than BATTERY_FILTER_RESET_MV (e.g. after charging)
+#define BATTERY_SAMPLES 16
+#define BATTERY_FILTER 4
+#define BATTERY_FILTER_RESET_MV 200
+
+// power tiers by state of charge (%), a lower tier is left again only after
+// state of charge has risen BATTERY_HYSTERESIS_SOC above its threshold
+// low: SDS011 only used every BATTERY_LOW_PM_CYCLES observation, interval doubled
+// critical: SDS011 not used at all, interval quadrupled
+// hibernate: no observations and transmissions, wake up every
+// BATTERY_HIBERNATE_SECS only to check if battery has been recharged
+#define BATTERY_LOW_SOC 30
+#define BATTERY_CRITICAL_SOC 15
+#define BATTERY_HIBERNATE_SOC 5
+#define BATTERY_HYSTERESIS_SOC 5
+#define BATTERY_LOW_PM_CYCLES 2
+#define BATTERY_HIBERNATE_SECS 3600
+
+enum batteryTier {
+    BATTERY_NORMAL = 0,
+    BATTERY_LOW = 1,
+    BATTERY_CRITICAL = 2,
+    BATTERY_HIBERNATE = 3
+};
+
+uint16_t battery_read();
+uint16_t battery_mv();
+uint8_t battery_soc();
+uint8_t battery_level();
+uint8_t battery_tier();
+bool battery_skip_pm();
+uint16_t battery_interval(uint16_t secs);
+void battery_hibernate();
+
+#endif
@@ -27,6 +27,37 @@
 // Feather M0 will sleep inbetween transmissions to save battery
 #define OBSERVATION_INTERVAL_SECS 600
 
+// adapt observation interval (within given bounds) to PM dynamics and battery
+// state: longer if PM values are low and stable or battery is draining, shorter
+// if PM values change quickly; interval is reported in payload (version 4)
+//#define ADAPTIVE_INTERVAL
+#define OBSERVATION_INTERVAL_MIN_SECS 300
+#define OBSERVATION_INTERVAL_MAX_SECS 3600
+
+// shorten observation interval and send observation immediately (also
+// buffered ones, see LORAWAN_BATCH_SIZE) if PM values exceed limits or
+// rise quickly; alert is reported in payload (version 4, see alert.h)
+//#define PM_ALERTS
+
+// accumulate energy and timing counters (MCU awake and standby, SDS011 fan,
+// radio TX and RX, SDS011 errors, joins) across cycles and resets, send them
+// on a separate port once a day or on request by downlink (see diag.h)
+//#define DIAGNOSTICS
+
+// change observation interval, SDS011 warmup and averaging and optional
+// payload fields by downlink on port 5, settings are kept in flash and
+// acknowledged with the next observation (see settings.h)
+//#define REMOTE_SETTINGS
+
+// measure drift of the RTC with LoRaWAN network time (LORAWAN_NETWORKTIME),
+// compensate it and request network time less often while the RTC keeps
+// time (see rtc.h); without it network time is requested every 30 uplinks
+//#define RTC_CALIBRATION
+
+// measure elapsed cycles of hot code paths (SysTick, see profile.h) and
+// print min/mean/max every PROFILE_DUMP_CYCLES cycles (requires SERIAL_BAUD)
+//#define PROFILING
+
 // OTAA/ABP: byte array(8), little endian format (LSB)
 #define LORAWAN_DEV_EUI { 0x11, 0x22, 0x33, 0x44, 0x08, 0x79, 0x30, 0x70 } 
 
@@ -40,7 +71,49 @@
 // undefine to disable serial output
 #define SERIAL_BAUD 9600
 
+// transmit serial output in the background (DMA) instead of waiting
+// for each log message to be sent (requires SERIAL_BAUD), see include/logsink.h
+// not validated on hardware yet, so disabled by default
+//#define LOG_DMA
+
+// write compact binary log records (token, timestamp and arguments) instead
+// of formatted log messages; reduces image size and time spent on logging,
+// use tools/logdecode.py to turn them back into log messages
+//#define LOG_TOKENIZED
+
+// log levels per module (LOG_NONE, LOG_ERROR, LOG_WARN, LOG_INFO, LOG_DEBUG),
+// log calls above the level of a module are removed including their strings
+#define LOG_NONE 0
+#define LOG_ERROR 1
+#define LOG_WARN 2
+#define LOG_INFO 3
+#define LOG_DEBUG 4
+#define LOG_LEVEL LOG_INFO
+#define LOG_LEVEL_LORAWAN LOG_LEVEL  // LoRaWAN stack, session, airtime
+#define LOG_LEVEL_SENSORS LOG_LEVEL  // sensors, SDS011, adaptive interval
+#define LOG_LEVEL_STORAGE LOG_LEVEL  // flash log, observation buffer
+#define LOG_LEVEL_SYSTEM LOG_LEVEL   // setup, sleep, battery
+
+// blink LED on startup, wakeup, join and TX (keeps MCU awake)
+#define LED_PATTERNS
+
 // for testing without sensors
 //#define NOSENSORS
 
+// production build (env:adafruit_feather_m0_production in platformio.ini)
+// without serial output, log messages and LED patterns to save power
+#ifdef PRODUCTION
+#undef SERIAL_BAUD
+#undef LOG_TOKENIZED
+#undef LOG_DMA
+#undef LED_PATTERNS
+#undef PROFILING
+#endif
+
+// host-side simulator (env:native in platformio.ini, see sim/include/sim.h)
+// log messages are written to Serial1 directly, there's no DMA controller
+#ifdef SIMULATOR
+#undef LOG_DMA
+#endif
+
 #endif
@@ -0,0 +1,66 @@
+/***************************************************************************
+  Copyright (c) 2024 Lars Wessels
+
+  This file is part of the "Feather-M0-LoRaWAN-PM-Sensor" source code.
+  https://github.com/lrswss/feather-m0-lorawan-pm-sensor
+
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+   
+  http://www.apache.org/licenses/LICENSE-2.0
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+***************************************************************************/
+
+#ifndef _DIAG_H
+#define _DIAG_H
+
+#include <Arduino.h>
+#include "config.h"
+
+// diagnostics counters are accumulated since the firmware was flashed and
+// kept in flash (written alternately to DIAG_ROWS rows on every report and
+// after reset); they are sent on port DIAG_PORT every DIAG_REPORT_SECS
+// (uptime) and on request (any downlink on DIAG_PORT)
+#define DIAG_PORT 4
+#define DIAG_REPORT_SECS 86400
+#define DIAG_ROWS 2
+#define DIAG_MAGIC 0x47414944 // 'DIAG'
+
+// payload: version byte followed by counters (see diagCounter_t)
+// as LEB128 varints, decoded by decoderTTN3.js
+#define DIAG_PAYLOAD_VERSION 1
+#define DIAG_MAX_SIZE (1 + DIAG_COUNTERS * 5)
+
+typedef enum {
+    DIAG_AWAKE_MS,        // MCU active or idle
+    DIAG_STANDBY_SECS,    // MCU in standby
+    DIAG_FAN_MS,          // SDS011 fan and laser diode on
+    DIAG_TX_MS,           // time on air of uplinks and join requests
+    DIAG_RX_MS,           // receive windows (estimated, see airtime_rx_ms())
+    DIAG_SDS011_RETRIES,  // SDS011 commands repeated due to missing reply
+    DIAG_SDS011_TIMEOUTS, // no (matching) reply from SDS011
+    DIAG_JOINS,           // join requests sent
+    DIAG_RESETS,          // startups
+    DIAG_COUNTERS
+} diagCounter_t;
+
+#ifdef DIAGNOSTICS
+void diag_init();
+void diag_add(diagCounter_t counter, uint32_t value);
+void diag_request();
+bool diag_due();
+uint8_t diag_encode(uint8_t *buf);
+void diag_sent();
+#else
+#define diag_init() ((void)0)
+#define diag_add(counter, value) ((void)0)
+#endif
+
+#endif
@@ -0,0 +1,47 @@
+/***************************************************************************
+  Copyright (c) 2024 Lars Wessels
+
+  This file is part of the "Feather-M0-LoRaWAN-PM-Sensor" source code.
+  https://github.com/lrswss/feather-m0-lorawan-pm-sensor
+
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+   
+  http://www.apache.org/licenses/LICENSE-2.0
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+***************************************************************************/
+
+#ifndef _INTERVAL_H
+#define _INTERVAL_H
+
+#include <Arduino.h>
+#include "config.h"
+#include "sensors.h"
+
+// PM values (μg/m3) below these limits are considered low
+#define INTERVAL_PM25_LOW 10
+#define INTERVAL_PM10_LOW 20
+
+// relative change of PM values between consecutive observations (%),
+// considered stable below INTERVAL_STABLE_PCT, fast above INTERVAL_FAST_PCT;
+// changes below INTERVAL_CHANGE_MIN (μg/m3) are always considered stable
+#define INTERVAL_STABLE_PCT 15
+#define INTERVAL_FAST_PCT 40
+#define INTERVAL_CHANGE_MIN 2
+
+// battery is considered draining if its (filtered) voltage dropped by at
+// least this value (mV) since the interval was last adapted to it
+#define INTERVAL_VBAT_DRAIN_MV 20
+
+uint16_t interval_update(sensorReadings_t *readings);
+uint16_t interval_current();
+void interval_reset();
+
+#endif
@@ -0,0 +1,51 @@
+/***************************************************************************
+  Copyright (c) 2024 Lars Wessels
+
+  This file is part of the "Feather-M0-LoRaWAN-PM-Sensor" source code.
+  https://github.com/lrswss/feather-m0-lorawan-pm-sensor
+
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+   
+  http://www.apache.org/licenses/LICENSE-2.0
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+***************************************************************************/
+
+#ifndef _LOGSINK_H
+#define _LOGSINK_H
+
+#include <Arduino.h>
+
+// log output is copied into a ring buffer and transmitted in the background
+// by the DMA controller (Serial1 on RX0/TX1 is SERCOM0 on the Feather M0),
+// writes which don't fit into the buffer are dropped completely
+#define LOGSINK_BUFFER_SIZE 1024
+#define LOGSINK_DMA_CHANNEL 0
+#define LOGSINK_SERCOM SERCOM0
+#define LOGSINK_DMA_TRIGGER SERCOM0_DMAC_ID_TX
+
+// added to the time required to transmit a full buffer before
+// flush() gives up waiting (e.g. if DMA transfer got stuck)
+#define LOGSINK_FLUSH_MARGIN_MS 20
+
+class LogSink : public Print {
+    public:
+        void begin(unsigned long baud);
+        size_t write(uint8_t c);
+        size_t write(const uint8_t *buf, size_t len);
+        using Print::write;
+        void flush();
+        uint32_t overflows();
+        operator bool() { return true; }
+};
+
+extern LogSink logSink;
+
+#endif
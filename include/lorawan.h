@@ -22,21 +22,31 @@
 #define _LORAWAN_H
 
 #include <Arduino.h>
-#include <avr/dtostrf.h>
 #include <lmic.h>
 #include <hal/hal.h>
 #include <SPI.h>
+#include "config.h"
 
 // enable ADR (adaptive rate) only makes
 // sense for nodes which are not moving
 #define LORAWAN_ADR
 
+// join attempts per observation cycle, the MCU sleeps between attempts;
+// observations are kept in flash log (if enabled) while not joined
+#define LORAWAN_JOIN_ATTEMPTS 3
+#define LORAWAN_JOIN_RETRY_SECS 20
+#define LORAWAN_JOIN_TIMEOUT_SECS 20
+
 // enable or disable LMIC LinkCheckMode (enable by default in LMIC)
 // this can eventually lead to EV_LINK_DEAD if sensor is unable to 
 // receive any downlink messages; however it can also trigger a rejoin
 // https://forum.mcci.io/t/lmic-setlinkcheckmode-questions/96/2
 #define LORAWAN_LINKCHECK
 
+// max. clock error (%) of LMIC's timer, receive windows are opened
+// earlier and kept open longer accordingly (LMIC_setClockError())
+#define LORAWAN_CLOCK_ERROR_PCT 2
+
 // sync RTC with LoRaWAN network time
 // tested with TTN Stack v3 and ChirpStack
 #define LORAWAN_NETWORKTIME
@@ -44,9 +54,39 @@
 // send battery level if requested by LNS
 #define LORAWAN_MAC_BATLEVEL
 
+// save LoRaWAN session (keys, frame counters, channels, data rate) in flash
+// after join and every given number of uplinks; restore it after reset
+// instead of joining again (see session.h)
+//#define LORAWAN_PERSIST_SESSION
+#define LORAWAN_SESSION_SAVE 16
+
+// keep track of airtime and stretch observation interval to stay
+// within EU868 duty cycle and TTN fair use policy (see airtime.h)
+//#define LORAWAN_AIRTIME_BUDGET
+
 // to allow changes or different payloads send a version number
+// version 2 (TLV, max. 18 bytes), 3 (bit-packed, max. 10 bytes)
+// or 4 (bit-packed with extension fields), see payload.h
 #define LORAWAN_PAYLOAD_VERSION 2
 
+// buffer given number of observations and send them in one batch frame
+// on port 2 (payload version 4), frame size is limited by the
+// max. payload size of the current data rate
+//#define LORAWAN_BATCH_SIZE 3
+
+// keep all observations in a log in flash until they have been sent;
+// observations taken while not joined or which could not be transmitted
+// are sent later on port 3 (rate limited, see obslog.h)
+//#define LORAWAN_STORE_FORWARD
+
+// observations are only marked as sent in flash log if the network server
+// has acknowledged a confirmed uplink; backlog frames are always confirmed,
+// observation frames every given number of seconds (the ack also covers the
+// unconfirmed frames sent before) or if LORAWAN_ACK_PAGES are waiting for it;
+// observations of frames without ack are sent again as backlog
+#define LORAWAN_CONFIRM_SECS 10800
+#define LORAWAN_ACK_PAGES 32
+
 enum lmic_states {
     NONE,
     IDLE,
@@ -61,8 +101,21 @@ extern lmic_states lmic_status;
 
 void lmic_init();
 void lmic_send();
-bool lmic_join(uint8_t repeat);
+bool lmic_join(uint8_t attempt);
+void lmic_join_cancel();
 void lmic_clear();
+bool lmic_idle(uint16_t secs);
+void lmic_standby(uint32_t ms);
+uint32_t lmic_txwait();
+void lmic_notify(void (*func)());
+uint16_t lmic_interval(uint16_t secs);
+#ifdef LORAWAN_STORE_FORWARD
+void lmic_store();
+bool lmic_replay();
+#endif
+#ifdef DIAGNOSTICS
+bool lmic_diagnostics();
+#endif
 uint8_t os_getBattLevel(void);
 
 #endif
\ No newline at end of file
@@ -0,0 +1,46 @@
+/***************************************************************************
+  Copyright (c) 2024 Lars Wessels
+
+  This file is part of the "Feather-M0-LoRaWAN-PM-Sensor" source code.
+  https://github.com/lrswss/feather-m0-lorawan-pm-sensor
+
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+   
+  http://www.apache.org/licenses/LICENSE-2.0
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+***************************************************************************/
+
+#ifndef _NVM_H
+#define _NVM_H
+
+#include <Arduino.h>
+
+// SAMD21 flash is erased in rows (4 pages) and written in pages
+#define NVM_PAGE_SIZE 64
+#define NVM_ROW_SIZE (NVM_PAGE_SIZE * 4)
+
+// reserve given number of flash rows, initialized with zeros when firmware is
+// flashed; always access through nvm_read() since content changes at runtime
+// (simulator on host has no flash, area is placed in writable memory)
+#ifdef SIMULATOR
+#define NVM_AREA(name, rows) \
+    __attribute__((__aligned__(NVM_ROW_SIZE))) static uint8_t name[(rows) * NVM_ROW_SIZE] = { }
+#else
+#define NVM_AREA(name, rows) \
+    __attribute__((__aligned__(NVM_ROW_SIZE))) static const uint8_t name[(rows) * NVM_ROW_SIZE] = { }
+#endif
+
+void nvm_read(const volatile void *addr, void *data, uint16_t size);
+void nvm_write(const volatile void *addr, const void *data, uint16_t size);
+void nvm_erase(const volatile void *addr);
+bool nvm_blank(const volatile void *addr, uint16_t size);
+
+#endif
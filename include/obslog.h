@@ -0,0 +1,42 @@
+/***************************************************************************
+  Copyright (c) 2024 Lars Wessels
+
+  This file is part of the "Feather-M0-LoRaWAN-PM-Sensor" source code.
+  https://github.com/lrswss/feather-m0-lorawan-pm-sensor
+
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+   
+  http://www.apache.org/licenses/LICENSE-2.0
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+***************************************************************************/
+
+#ifndef _OBSLOG_H
+#define _OBSLOG_H
+
+#include <Arduino.h>
+#include "sensors.h"
+
+// circular log in flash with one observation per page (64 bytes); rows are
+// erased when the log wraps around, so each row is erased only once every
+// OBSLOG_ROWS * 4 observations (~42h at 10 min. intervals with 64 rows)
+#define OBSLOG_ROWS 64
+#define OBSLOG_MAGIC 0x4F42534C // 'OBSL'
+
+// send at most one backlog frame (port 3) every given number of seconds
+#define OBSLOG_REPLAY_SECS 300
+
+void obslog_init();
+uint16_t obslog_append(sensorReadings_t *readings, uint32_t timestamp);
+void obslog_sent(uint16_t page);
+uint16_t obslog_pending();
+uint8_t obslog_backlog(uint8_t *buf, uint8_t maxlen, uint32_t now, uint16_t *pages, uint8_t maxpages, uint8_t *added);
+
+#endif
@@ -0,0 +1,99 @@
+/***************************************************************************
+  Copyright (c) 2024 Lars Wessels
+
+  This file is part of the "Feather-M0-LoRaWAN-PM-Sensor" source code.
+  https://github.com/lrswss/feather-m0-lorawan-pm-sensor
+
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+   
+  http://www.apache.org/licenses/LICENSE-2.0
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+***************************************************************************/
+
+#ifndef _PAYLOAD_H
+#define _PAYLOAD_H
+
+#include <Arduino.h>
+#include "sensors.h"
+
+// payload version 2: tag byte and 16-bit value for each field (max. 18 bytes)
+// payload version 3: bit-packed fields without tags (max. 10 bytes), which
+// fields are present follows from the sensor status byte (see decoderTTN3.js)
+// payload version 4: as version 3 with additional extension byte (byte 2),
+// extension fields flagged there are appended to the bit stream
+//
+// byte 0: payload version
+// byte 1: sensor status
+// byte 2: extension flags (PAYLOAD_EXT_*, version 4 only)
+// byte 2/3: battery voltage (V * 100 - 256, 0 if not connected)
+// temperature/humidity (only if SENSORS_HAS_BME280|SHT31|SI7021 is set)
+//   11 bits: temperature (°C * 10 + 400, 0x7FF if invalid)
+//    7 bits: humidity (%, 0x7F if invalid)
+// pressure (only if SENSORS_HAS_BME280 is set)
+//   12 bits: pressure ((hPa - 500) * 5)
+// PM2.5 and PM10 (only if SENSORS_SDS011_ERROR and PAYLOAD_EXT_NO_PM are not set,
+// version 3 sets SENSORS_SDS011_ERROR if SDS011 was skipped to save battery)
+//   10 bits each: 0-499 = μg/m3 * 10 (< 50 μg/m3), 500-1023 = 50 + (code - 500) * 2 μg/m3
+// extension fields (version 4 only) in order of their flags
+//   PAYLOAD_EXT_INTERVAL: 8 bits, observation interval in minutes
+//   PAYLOAD_EXT_NO_PM: no field, SDS011 skipped to save battery
+//   PAYLOAD_EXT_BATTERY: 7 bits state of charge (%), 2 bits power tier
+//   (only if power tier is not BATTERY_NORMAL)
+//   PAYLOAD_EXT_STATS: 8 bits number of SDS011 readings, min., max. and
+//   standard deviation of PM2.5 and PM10 readings (10 bits each, see above)
+//   (only if PAYLOAD_PM_STATS is set)
+//   PAYLOAD_EXT_ALERT: 3 bits PM alert reasons (see alert.h)
+//   PAYLOAD_EXT_SETTINGS: 8 bits acknowledge of remote settings (see settings.h)
+// extension fields can be turned off remotely (except PAYLOAD_EXT_NO_PM)
+// remaining bits of last byte are zero
+#define PAYLOAD_V3_TEMP_BITS 11
+#define PAYLOAD_V3_HUM_BITS 7
+#define PAYLOAD_V3_PRES_BITS 12
+#define PAYLOAD_V3_PM_BITS 10
+
+// append statistics of SDS011 readings to observations (payload version 4),
+// adds 9 bytes to each observation; changes size of records in flash log
+// (see obslog.h), so records stored by previous firmware are discarded
+//#define PAYLOAD_PM_STATS
+
+#ifdef PAYLOAD_PM_STATS
+#define PAYLOAD_MAX_SIZE 23
+#else
+#define PAYLOAD_MAX_SIZE 18
+#endif
+
+enum payloadExtension {
+    PAYLOAD_EXT_INTERVAL = 0x01,
+    PAYLOAD_EXT_NO_PM = 0x02,
+    PAYLOAD_EXT_BATTERY = 0x04,
+    PAYLOAD_EXT_STATS = 0x08,
+    PAYLOAD_EXT_ALERT = 0x10,
+    PAYLOAD_EXT_SETTINGS = 0x20
+};
+
+// batch frame (port 2) and backlog frame from flash log (port 3):
+// payload version followed by buffered observations (oldest first)
+// each made up of a time offset (seconds before transmission, LEB128 varint)
+// and the observation encoded with PAYLOAD_BATCH_VERSION without version byte
+#define PAYLOAD_BUFFER_SIZE 8
+#define PAYLOAD_BATCH_VERSION 4
+
+uint8_t payload_encode(uint8_t *buf, uint8_t version, sensorReadings_t *readings);
+uint8_t payload_record(uint8_t *buf, sensorReadings_t *readings);
+bool payload_append(uint8_t *buf, uint8_t *len, uint8_t maxlen,
+    const uint8_t *record, uint8_t recordLen, uint32_t age);
+void payload_push(sensorReadings_t *readings, uint32_t timestamp, uint16_t tag);
+uint8_t payload_pending();
+uint16_t payload_tag(uint8_t i);
+uint8_t payload_batch(uint8_t *buf, uint8_t maxlen, uint32_t now, uint8_t *added);
+void payload_drop(uint8_t dropped);
+
+#endif
@@ -0,0 +1,65 @@
+/***************************************************************************
+  Copyright (c) 2024 Lars Wessels
+
+  This file is part of the "Feather-M0-LoRaWAN-PM-Sensor" source code.
+  https://github.com/lrswss/feather-m0-lorawan-pm-sensor
+
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+   
+  http://www.apache.org/licenses/LICENSE-2.0
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+***************************************************************************/
+
+#ifndef _PROFILE_H
+#define _PROFILE_H
+
+#include <Arduino.h>
+#include "config.h"
+
+// print profiling table every given number of observation cycles
+#define PROFILE_DUMP_CYCLES 6
+
+// code sections measured with PROFILE(), nested sections are
+// included in the outer one (e.g. log messages in onEvent())
+typedef enum {
+    PROFILE_SDS011_CMD,   // SDS011::cmd()
+    PROFILE_SDS011_READ,  // SDS011::read(), waiting for response frame
+    PROFILE_SDS011_POLL,  // SDS011::poll()
+    PROFILE_I2C_READ,     // reading BME280, SHT31 or Si7021
+    PROFILE_LMIC_TXDATA,  // lmic_txdata()
+    PROFILE_LOG_MSG,      // log_msg()
+    PROFILE_ON_EVENT,     // onEvent()
+    PROFILE_SECTIONS
+} profileSection_t;
+
+#ifdef PROFILING
+// measures elapsed core clock cycles (SysTick, including time spent in
+// idle mode) from construction until end of scope, adds them to table
+class ProfileScope {
+    public:
+        ProfileScope(profileSection_t section);
+        ~ProfileScope();
+    private:
+        profileSection_t section;
+        uint32_t start;
+};
+
+#define PROFILE_CONCAT(a, b) a##b
+#define PROFILE_SCOPE(section, line) ProfileScope PROFILE_CONCAT(profileScope, line)(section)
+#define PROFILE(section) PROFILE_SCOPE(section, __LINE__)
+
+void profile_dump();
+#else
+#define PROFILE(section) ((void)0)
+#define profile_dump() ((void)0)
+#endif
+
+#endif
@@ -23,9 +23,33 @@
 
 #include <Arduino.h>
 #include <RTCZero.h>
+#include "config.h"
+
+// drift of the RTC is measured between network time answers (DeviceTimeReq)
+// and compensated with its frequency correction register (steps of about
+// 1 ppm); the RTC is only set if it is off by RTC_SYNC_TOLERANCE_MS, network
+// time is requested again when the offset would reach RTC_SYNC_TOLERANCE_MS
+// at the residual drift (after correction), within RTC_SYNC_MIN_SECS and
+// RTC_SYNC_MAX_SECS, so requests get rarer while the RTC keeps time
+#define RTC_SYNC_TOLERANCE_MS 1000
+#define RTC_SYNC_MIN_SECS 21600UL   // 6 hours
+#define RTC_SYNC_MAX_SECS 604800UL  // 7 days
+#define RTC_FREQCORR_PPB 1024       // 1/976562
+#define RTC_FREQCORR_MAX 127
+#define RTC_CALIBRATION_MAGIC 0x43525443 // 'CTRC'
 
 extern RTCZero rtc;
 
+void idle();
 void sleep(uint16_t secs);
+uint16_t standby(uint16_t secs);
+uint32_t uptime_ms();
+#ifdef RTC_CALIBRATION
+void rtc_sync_init();
+void rtc_sync(uint32_t epoch, uint32_t ms);
+bool rtc_sync_due();
+#else
+#define rtc_sync_init() ((void)0)
+#endif
 
 #endif
\ No newline at end of file
@@ -0,0 +1,47 @@
+/***************************************************************************
+  Copyright (c) 2024 Lars Wessels
+
+  This file is part of the "Feather-M0-LoRaWAN-PM-Sensor" source code.
+  https://github.com/lrswss/feather-m0-lorawan-pm-sensor
+
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+   
+  http://www.apache.org/licenses/LICENSE-2.0
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+***************************************************************************/
+
+#ifndef _SCHEDULER_H
+#define _SCHEDULER_H
+
+#include <Arduino.h>
+#include <lmic.h>
+
+// min. time until next task is due (secs) to put MCU to standby,
+// otherwise it is kept in idle mode until next interrupt (SysTick)
+#define SCHEDULER_STANDBY_SECS 2
+
+// max. number of tasks (see scheduler_at())
+#define SCHEDULER_MAX_TASKS 4
+
+// task executed as LMIC job at given time (uptime_ms()), unlike
+// LMIC's clock its deadline includes the time spent in standby
+typedef struct {
+    osjob_t job;
+    osjobcb_t func;
+    uint32_t due;
+    bool timed;
+} schedulerTask_t;
+
+void scheduler_at(schedulerTask_t *task, osjobcb_t func, uint32_t due);
+void scheduler_in(schedulerTask_t *task, osjobcb_t func, uint32_t ms);
+void scheduler_run();
+
+#endif
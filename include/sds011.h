@@ -23,32 +23,58 @@
 
 #include "Arduino.h"
 #include "wiring_private.h"
+#include "sds011_parser.h"
+#include "stats.h"
 
 #define WARMUP_SECS 20
 #define READ_TIMEOUT_MS 1000
 #define CMD_RETRY 3
 #define CMD_RETRY_MS 500
+#define RX_FRAMES 4
 #define AVG_READINGS 3
 #define AVG_READINGS_MS 1500
-//#define SDS_DEBUG
+
+// sample PM values during warmup and stop as soon as AVG_READINGS consecutive
+// readings are within given tolerance (not before WARMUP_MIN_SECS, at the latest
+// after WARMUP_SECS); reduces runtime of fan and laser diode (~110mA)
+//#define SDS_ADAPTIVE_WARMUP
+#define WARMUP_MIN_SECS 8
+#define CONVERGE_TOLERANCE_PCT 10 // relative to previous reading
+#define CONVERGE_TOLERANCE_MIN 10 // 1/10 μg/m3, used for low PM values
 
 class SDS011 {
 	public:
 		SDS011(uint8_t secs);
 		void begin();
         bool ready();
-		bool poll(float *pm25, float *pm10, uint8_t repeat = 0);
+        uint16_t warmupLeft();
+		bool poll(int16_t *pm25, int16_t *pm10, uint8_t repeat = 0);
         bool info(char *version, uint16_t& id);
 		bool wakeup();
         bool sleep();
+        void configure(uint8_t secs, uint8_t readings, uint16_t readingsMs);
+        uint8_t pollSamples();
+        uint16_t pollSecs();
+        void pollStats(statsSummary_t *pm25, statsSummary_t *pm10);
 	private:
-        uint8_t rxbuf[10]; // SDS011 reponse has 10 byte
+        uint8_t rxbuf[SDS011_FRAME_LEN]; // SDS011 reponse has 10 byte
         uint32_t startTime;
         uint8_t warmupSecs;
+        uint8_t avgReadings;
+        uint16_t avgReadingsMs;
+        uint8_t usedSamples;
+        uint16_t usedSecs;
+        stats_t pm25Stats, pm10Stats;
+#ifdef SDS_ADAPTIVE_WARMUP
+        bool converged;
+        uint32_t lastSample;
+        uint16_t lastPm25, lastPm10;
+        void sample();
+#endif
+        void restart();
         bool read(uint8_t cmd, uint8_t data1 = 0);
         bool passiveMode();
         uint8_t calcCRC(uint8_t *buf);
-        bool checkCRC(uint8_t *buf, uint8_t crc);
         bool cmd(const uint8_t *cmd, const char *name);
 };
 
@@ -0,0 +1,68 @@
+/***************************************************************************
+  Copyright (c) 2024 Lars Wessels
+
+  This file is part of the "Feather-M0-LoRaWAN-PM-Sensor" source code.
+  https://github.com/lrswss/feather-m0-lorawan-pm-sensor
+
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+   
+  http://www.apache.org/licenses/LICENSE-2.0
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+***************************************************************************/
+
+#ifndef _SDS011_PARSER_H
+#define _SDS011_PARSER_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+#define SDS011_FRAME_LEN 10
+#define SDS011_FRAME_HEAD 0xAA
+#define SDS011_FRAME_TAIL 0xAB
+#define SDS011_REPLY_DATA 0xC0
+#define SDS011_REPLY_CMD 0xC5
+
+// view on a complete response frame held by SDS011Parser
+// AA C0|C5 D1 D2 D3 D4 D5 D6 CRC AB (CRC = sum of D1..D6)
+typedef struct {
+    uint8_t head;
+    uint8_t cmd;
+    uint8_t data[6];
+    uint8_t crc;
+    uint8_t tail;
+
+    // 0xC0 data reply: PM values in 1/10 μg/m3
+    uint16_t pm25() const { return (data[1] << 8) | data[0]; }
+    uint16_t pm10() const { return (data[3] << 8) | data[2]; }
+    // 0xC5 command reply: id of command acknowledged
+    uint8_t reply() const { return data[0]; }
+    uint16_t id() const { return (data[4] << 8) | data[5]; }
+} SDS011Frame;
+
+// incremental parser for SDS011 response frames without any dependency
+// on Arduino or UART; bytes can be fed from any source (also from an ISR)
+class SDS011Parser {
+    public:
+        SDS011Parser();
+        const SDS011Frame* feed(uint8_t c);
+        void reset();
+        uint32_t frames() const { return frameCount; }
+        uint32_t dropped() const { return dropCount; }
+    private:
+        uint8_t buf[SDS011_FRAME_LEN];
+        uint8_t pos;
+        uint32_t frameCount;
+        uint32_t dropCount;
+        bool valid() const;
+        void resync();
+};
+
+#endif
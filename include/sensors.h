@@ -23,7 +23,6 @@
 
 #include <Arduino.h>
 #include "config.h"
-#include <avr/dtostrf.h>
 #include <SPI.h>
 #include <Wire.h>
 #include <Adafruit_Sensor.h>
@@ -31,9 +30,12 @@
 #include <Adafruit_SHT31.h>
 #include <Adafruit_Si7021.h>
 #include "sds011.h"
+#include "battery.h"
 
 
-// sensors will be tried in the following order: BME280, SHT31, SI7021
+// sensors will be tried in the following order: BME280, SHT31, SI7021;
+// only their addresses are probed, the sensor found is kept in flash and
+// initialized directly on next startup (probing again if that fails)
 
 // BMP/BME280 I2C address
 #define BMP_BME280_ADDRESS 0x76
@@ -44,19 +46,43 @@
 // I2C address for SI7021 / SHT21 (temperature/humidity sensor)
 #define SI7021_ADDRESS 0x40
 
-// set according to values of voltage divider on VBAT_PIN
-#define VBAT_MULTIPLIER 2.0
-#define VBAT_MIN_LEVEL 3.5
-#define VBAT_MAX_LEVEL 4.21
+// I2C clock (fast mode), supported by all sensors above
+#define I2C_CLOCK_HZ 400000
+
+// scan all I2C addresses on startup and log devices found (diagnostics)
+//#define I2C_SCAN
+
+#define SENSORS_CONFIG_MAGIC 0x464E4353 // 'SCNF'
+
+// max. conversion time (ms) of temperature/humidity sensors, conversion
+// is started before SDS011 is polled and collected afterwards
+#define BME280_CONV_MS 10  // forced mode, 1x oversampling (9.3 ms)
+#define SHT31_CONV_MS 16   // single shot, high repeatability (15 ms)
+#define SI7021_CONV_MS 25  // humidity 12 bit and temperature 14 bit (22.8 ms)
+
+// poll interval (ms) while SDS011 is sampled during adaptive warmup
+#define SENSORS_POLL_MS 250
+
+// fixed-point readings (no soft-float on Cortex-M0),
+// converted from/to float only in sensor libraries
+#define SENSORS_TEMP_INVALID -9900
 
 typedef struct  {
-    float temperature;
-    float pressure;
-    int8_t humidity;
-    float pm10;
-    float pm25;
-    double vbat;
+    int16_t temperature; // °C * 100 (SENSORS_TEMP_INVALID if invalid)
+    uint16_t pressure; // hPa * 10 (0 if invalid)
+    int8_t humidity; // % (-1 if invalid)
+    int16_t pm10; // μg/m3 * 10 (-1 if not available)
+    int16_t pm25; // μg/m3 * 10 (-1 if not available)
+    uint16_t vbat; // mV (0 if not connected)
     byte status;
+    uint16_t interval; // secs until next observation (0 if not reported)
+    uint8_t soc; // battery state of charge (%)
+    uint8_t power; // power tier (see battery.h)
+    uint8_t pmSamples; // SDS011 readings averaged (0 if no PM values)
+    statsSummary_t pm25Stats; // min, max, std. deviation of PM2.5 readings
+    statsSummary_t pm10Stats;
+    uint8_t alert; // PM alert reasons (see alert.h)
+    int16_t settingsAck; // remote settings acknowledge (-1 if none, see settings.h)
 } sensorReadings_t;
 
 enum sensorStatus {
@@ -78,6 +104,7 @@ void sensors_read(bool verbose);
 void sensors_off();
 void sensors_warmup();
 bool sensors_ready();
+uint16_t sensors_warmup_secs();
 bool sensors_error();
 bool vbat_read(bool verbose);
 
@@ -0,0 +1,44 @@
+/***************************************************************************
+  Copyright (c) 2024 Lars Wessels
+
+  This file is part of the "Feather-M0-LoRaWAN-PM-Sensor" source code.
+  https://github.com/lrswss/feather-m0-lorawan-pm-sensor
+
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+   
+  http://www.apache.org/licenses/LICENSE-2.0
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+***************************************************************************/
+
+#ifndef _SESSION_H
+#define _SESSION_H
+
+#include <Arduino.h>
+#include <lmic.h>
+
+// LoRaWAN session is written to the next of SESSION_ROWS flash rows (one row
+// per copy) after join and every LORAWAN_SESSION_SAVE uplinks; after restore
+// the uplink counter is advanced by LORAWAN_SESSION_SAVE to avoid reusing
+// frame counters which were sent after the last save
+#define SESSION_ROWS 8
+#define SESSION_MAGIC 0x4C534553 // 'SESL'
+
+// DevNonce saved in flash is kept ahead of the ones used for join requests,
+// it's advanced by given number whenever the reserved nonces have been used
+#define SESSION_NONCE_RESERVE 16
+
+bool session_restore();
+void session_save();
+void session_clear();
+void session_joining();
+bool session_due();
+
+#endif
@@ -0,0 +1,80 @@
+/***************************************************************************
+  Copyright (c) 2024 Lars Wessels
+
+  This file is part of the "Feather-M0-LoRaWAN-PM-Sensor" source code.
+  https://github.com/lrswss/feather-m0-lorawan-pm-sensor
+
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+   
+  http://www.apache.org/licenses/LICENSE-2.0
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+***************************************************************************/
+
+#ifndef _SETTINGS_H
+#define _SETTINGS_H
+
+#include <Arduino.h>
+#include "config.h"
+#include "payload.h"
+#include "sds011.h"
+
+// downlink on port SETTINGS_PORT: sequence of commands, each a command
+// byte followed by its value (big endian); all commands of a downlink are
+// validated against the bounds below before any is applied, settings are
+// kept in flash and the result is reported with the next observation
+// (PAYLOAD_EXT_SETTINGS: applied/rejected and revision of settings)
+#define SETTINGS_PORT 5
+#define SETTINGS_MAGIC 0x54455353 // 'SSET'
+
+enum settingsCommand {
+    SETTINGS_CMD_INTERVAL = 0x01,  // 16 bits, observation interval (secs)
+    SETTINGS_CMD_WARMUP = 0x02,    // 8 bits, max. SDS011 warmup (secs)
+    SETTINGS_CMD_READINGS = 0x03,  // 8 bits, SDS011 readings averaged
+    SETTINGS_CMD_READINGS_MS = 0x04, // 16 bits, pause between SDS011 readings (ms)
+    SETTINGS_CMD_FIELDS = 0x05,    // 8 bits, optional payload fields (SETTINGS_FIELDS)
+    SETTINGS_CMD_DEFAULTS = 0xFF   // no value, restore compiled in settings
+};
+
+// bounds for settings, observation interval within
+// OBSERVATION_INTERVAL_MIN_SECS and OBSERVATION_INTERVAL_MAX_SECS
+#define SETTINGS_WARMUP_MIN WARMUP_MIN_SECS
+#define SETTINGS_WARMUP_MAX 30
+#define SETTINGS_READINGS_MIN 1
+#define SETTINGS_READINGS_MAX 5
+#define SETTINGS_READINGS_MS_MIN 1000 // SDS011 updates readings every second
+#define SETTINGS_READINGS_MS_MAX 5000
+
+// extension fields of payload version 4 which can be turned off
+#define SETTINGS_FIELDS (PAYLOAD_EXT_INTERVAL|PAYLOAD_EXT_BATTERY|PAYLOAD_EXT_STATS|PAYLOAD_EXT_ALERT)
+
+// acknowledge reported in payload: bit 7 set if downlink was applied,
+// bits 0-6 revision of settings (incremented with every change)
+#define SETTINGS_ACK_APPLIED 0x80
+
+typedef struct {
+    uint16_t interval;     // observation interval (secs)
+    uint8_t warmupSecs;    // max. SDS011 warmup (secs)
+    uint8_t readings;      // SDS011 readings averaged
+    uint16_t readingsMs;   // pause between SDS011 readings (ms)
+    uint8_t fields;        // optional payload fields (PAYLOAD_EXT_*)
+} settings_t;
+
+extern settings_t settings;
+
+#ifdef REMOTE_SETTINGS
+void settings_init();
+void settings_downlink(const uint8_t *buf, uint8_t len);
+int16_t settings_ack();
+#else
+#define settings_init() ((void)0)
+#endif
+
+#endif
@@ -0,0 +1,52 @@
+/***************************************************************************
+  Copyright (c) 2024 Lars Wessels
+
+  This file is part of the "Feather-M0-LoRaWAN-PM-Sensor" source code.
+  https://github.com/lrswss/feather-m0-lorawan-pm-sensor
+
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+   
+  http://www.apache.org/licenses/LICENSE-2.0
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+***************************************************************************/
+
+#ifndef _STATS_H
+#define _STATS_H
+
+#include <Arduino.h>
+
+// streaming statistics over fixed-point values (e.g. PM in μg/m3 * 10)
+// in constant memory, samples are not stored; the trimmed mean drops
+// min. and max. value and is therefore robust to a single spike
+// (equals the median for 3 samples)
+typedef struct {
+    uint16_t count;
+    int16_t min;
+    int16_t max;
+    int32_t sum;
+    uint64_t sumsq;
+} stats_t;
+
+// summary of statistics for observation payload
+typedef struct {
+    int16_t min;
+    int16_t max;
+    uint16_t stddev;
+} statsSummary_t;
+
+void stats_reset(stats_t *stats);
+void stats_add(stats_t *stats, int16_t value);
+int16_t stats_mean(const stats_t *stats);
+int16_t stats_trimmed(const stats_t *stats);
+uint16_t stats_stddev(const stats_t *stats);
+void stats_summary(const stats_t *stats, statsSummary_t *summary);
+
+#endif
@@ -22,12 +22,87 @@
 #define _UTILS_H
 
 #include <Arduino.h>
+#include "config.h"
+#include "profile.h"
 
+#if defined(LOG_DMA) && defined(SERIAL_BAUD)
+#include "logsink.h"
+#define serial logSink
+#else
 #define serial Serial1
+#endif
 #define MAX_MSG 128
 
-void blink_led(uint16_t pause, uint8_t blinks);
+#ifdef LOG_TOKENIZED
+// tokenized log record (decode with tools/logdecode.py):
+// byte 0: LOG_RECORD_SYNC
+// byte 1: length of token, timestamp and arguments
+// 4 bytes: token (FNV-1a hash of format string, little endian)
+// varint: timestamp (ms, LEB128)
+// varint/string for each argument: integers as zigzag LEB128 varint,
+//   strings as length byte followed by (max. LOG_STRING_MAX) characters;
+//   strings are shortened and arguments dropped to fit into LOG_RECORD_MAX
+// byte n: CRC-8 of length byte up to last argument
+#define LOG_RECORD_SYNC 0xF5
+#define LOG_RECORD_MAX 64
+#define LOG_STRING_MAX 24
+
+// 32-bit FNV-1a hash of format string, evaluated at compile time
+constexpr uint32_t log_token(const char *fmt, uint32_t hash = 2166136261UL) {
+    return *fmt ? log_token(fmt + 1, (uint32_t)((hash ^ (uint8_t)*fmt) * 16777619UL)) : hash;
+}
+
+// forces evaluation of token at compile time, so
+// format strings are not included in firmware image
+template<uint32_t token> struct LogToken {
+    static const uint32_t value = token;
+};
+
+void log_begin(uint32_t token);
+void log_int(int64_t value);
+void log_str(const char *s);
+void log_end();
+
+template<typename T> inline void log_arg(T value) { log_int((int64_t)value); }
+inline void log_arg(const char *s) { log_str(s); }
+inline void log_arg(char *s) { log_str(s); }
+
+inline void log_args() {}
+template<typename T, typename... Args> inline void log_args(T first, Args... rest) {
+    log_arg(first);
+    log_args(rest...);
+}
+
+template<typename... Args> void log_record(uint32_t token, Args... args) {
+    PROFILE(PROFILE_LOG_MSG);
+    log_begin(token);
+    log_args(args...);
+    log_end();
+}
+
+#define log_msg(fmt, ...) log_record(LogToken<log_token(fmt)>::value, ##__VA_ARGS__)
+#else
 void log_msg(const char *fmt, ...);
+#endif
+
+// log message with given level, removed at compile time if level is above
+// LOG_MODULE (module log level, see config.h) or serial output is disabled
+#ifdef SERIAL_BAUD
+#define LOG_ENABLED(level) (LOG_MODULE >= (level))
+#else
+#define LOG_ENABLED(level) 0
+#endif
+#define log_error(...) do { if (LOG_ENABLED(LOG_ERROR)) log_msg(__VA_ARGS__); } while (0)
+#define log_warn(...) do { if (LOG_ENABLED(LOG_WARN)) log_msg(__VA_ARGS__); } while (0)
+#define log_info(...) do { if (LOG_ENABLED(LOG_INFO)) log_msg(__VA_ARGS__); } while (0)
+#define log_debug(...) do { if (LOG_ENABLED(LOG_DEBUG)) log_msg(__VA_ARGS__); } while (0)
+
+#ifdef LED_PATTERNS
+void blink_led(uint16_t pause, uint8_t blinks);
+#else
+#define blink_led(pause, blinks) ((void)0)
+#endif
 void print_hex(uint8_t *arr, uint8_t len, bool ln, bool reverse);
-float mapfloat(float x, float in_min, float in_max, float out_min, float out_max);
+char *fixstr(char *buf, int32_t value, uint8_t decimals);
+uint8_t crc8(const uint8_t *buf, uint16_t len);
 #endif
\ No newline at end of file
@@ -0,0 +1,57 @@
+/***************************************************************************
+  Copyright (c) 2024 Lars Wessels
+
+  This file is part of the "Feather-M0-LoRaWAN-PM-Sensor" source code.
+  https://github.com/lrswss/feather-m0-lorawan-pm-sensor
+
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+   
+  http://www.apache.org/licenses/LICENSE-2.0
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+***************************************************************************/
+
+// subset of the Adafruit BME280 library, register
+// access goes through the emulated device (sim_i2c.cpp)
+
+#ifndef _SIM_ADAFRUIT_BME280_H
+#define _SIM_ADAFRUIT_BME280_H
+
+#include "Wire.h"
+
+#define BME280_ADDRESS 0x77
+#define BME280_ADDRESS_ALTERNATE 0x76
+
+class Adafruit_BME280 {
+    public:
+        enum sensor_mode { MODE_SLEEP = 0, MODE_FORCED = 1, MODE_NORMAL = 3 };
+        enum sensor_sampling { SAMPLING_NONE, SAMPLING_X1, SAMPLING_X2, SAMPLING_X4, SAMPLING_X8, SAMPLING_X16 };
+        enum sensor_filter { FILTER_OFF, FILTER_X2, FILTER_X4, FILTER_X8, FILTER_X16 };
+        enum standby_duration { STANDBY_MS_0_5, STANDBY_MS_62_5, STANDBY_MS_125, STANDBY_MS_250,
+            STANDBY_MS_500, STANDBY_MS_1000, STANDBY_MS_10, STANDBY_MS_20 };
+
+        bool begin(uint8_t addr = BME280_ADDRESS, TwoWire *wire = &Wire);
+        uint32_t sensorID();
+        void setSampling(sensor_mode mode = MODE_NORMAL,
+            sensor_sampling tempSampling = SAMPLING_X16,
+            sensor_sampling pressSampling = SAMPLING_X16,
+            sensor_sampling humSampling = SAMPLING_X16,
+            sensor_filter filter = FILTER_OFF,
+            standby_duration duration = STANDBY_MS_0_5);
+        bool takeForcedMeasurement();
+        float readTemperature();
+        float readPressure();
+        float readHumidity();
+    private:
+        uint8_t addr = BME280_ADDRESS;
+        TwoWire *wire = &Wire;
+};
+
+#endif
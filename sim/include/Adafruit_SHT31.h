@@ -0,0 +1,46 @@
+/***************************************************************************
+  Copyright (c) 2024 Lars Wessels
+
+  This file is part of the "Feather-M0-LoRaWAN-PM-Sensor" source code.
+  https://github.com/lrswss/feather-m0-lorawan-pm-sensor
+
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+   
+  http://www.apache.org/licenses/LICENSE-2.0
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+***************************************************************************/
+
+// subset of the Adafruit SHT31 library (blocking single
+// shot measurements on the emulated device, see sim_i2c.cpp)
+
+#ifndef _SIM_ADAFRUIT_SHT31_H
+#define _SIM_ADAFRUIT_SHT31_H
+
+#include "Wire.h"
+
+#define SHT31_DEFAULT_ADDR 0x44
+
+class Adafruit_SHT31 {
+    public:
+        Adafruit_SHT31(TwoWire *wire = &Wire) : wire(wire) {}
+        bool begin(uint8_t addr = SHT31_DEFAULT_ADDR);
+        float readTemperature();
+        float readHumidity();
+        bool readBoth(float *temperature, float *humidity);
+        void reset();
+        void heater(bool enable);
+    private:
+        TwoWire *wire;
+        uint8_t addr = SHT31_DEFAULT_ADDR;
+        bool command(uint16_t cmd);
+};
+
+#endif
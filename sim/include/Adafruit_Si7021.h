@@ -0,0 +1,46 @@
+/***************************************************************************
+  Copyright (c) 2024 Lars Wessels
+
+  This file is part of the "Feather-M0-LoRaWAN-PM-Sensor" source code.
+  https://github.com/lrswss/feather-m0-lorawan-pm-sensor
+
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+   
+  http://www.apache.org/licenses/LICENSE-2.0
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+***************************************************************************/
+
+// subset of the Adafruit Si7021 library (blocking measurements
+// on the emulated device, see sim_i2c.cpp)
+
+#ifndef _SIM_ADAFRUIT_SI7021_H
+#define _SIM_ADAFRUIT_SI7021_H
+
+#include "Wire.h"
+
+#define SI7021_DEFAULT_ADDRESS 0x40
+
+class Adafruit_Si7021 {
+    public:
+        Adafruit_Si7021(TwoWire *wire = &Wire) : wire(wire) {}
+        bool begin();
+        float readTemperature();
+        float readHumidity();
+        void reset();
+        void heater(bool enable);
+        uint8_t getRevision() { return 2; }
+    private:
+        TwoWire *wire;
+        bool command(uint8_t cmd);
+        int32_t measure(uint8_t cmd, uint16_t ms);
+};
+
+#endif
@@ -0,0 +1,213 @@
+/***************************************************************************
+  Copyright (c) 2024 Lars Wessels
+
+  This file is part of the "Feather-M0-LoRaWAN-PM-Sensor" source code.
+  https://github.com/lrswss/feather-m0-lorawan-pm-sensor
+
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+   
+  http://www.apache.org/licenses/LICENSE-2.0
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+***************************************************************************/
+
+// minimal Arduino API for running the firmware on the host (see sim.h),
+// only what is used by the firmware is provided
+
+#ifndef _SIM_ARDUINO_H
+#define _SIM_ARDUINO_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdarg.h>
+#include <math.h>
+
+typedef uint8_t byte;
+typedef bool boolean;
+
+#define HIGH 1
+#define LOW 0
+#define INPUT 0
+#define OUTPUT 1
+#define LED_BUILTIN 13
+#define A7 9
+#define F(s) (s)
+#define F_CPU 48000000L
+
+#ifndef min
+#define min(a, b) ((a) < (b) ? (a) : (b))
+#define max(a, b) ((a) > (b) ? (a) : (b))
+#endif
+#define constrain(amt, low, high) ((amt) < (low) ? (low) : ((amt) > (high) ? (high) : (amt)))
+
+// virtual time (see sim_clock.cpp), stopped in standby like SysTick
+uint32_t millis();
+uint32_t micros();
+void delay(uint32_t ms);
+void delayMicroseconds(uint32_t us);
+void __WFI();
+void __DSB();
+void noInterrupts();
+void interrupts();
+
+void pinMode(uint32_t pin, uint32_t mode);
+void digitalWrite(uint32_t pin, uint32_t value);
+int analogRead(uint32_t pin);
+void analogReadResolution(int bits);
+char *itoa(int value, char *buf, int base);
+
+
+class Print {
+    public:
+        virtual ~Print() {}
+        virtual size_t write(uint8_t c) = 0;
+        virtual size_t write(const uint8_t *buf, size_t len);
+        size_t write(const char *s) { return write((const uint8_t *)s, strlen(s)); }
+        size_t write(const char *buf, size_t len) { return write((const uint8_t *)buf, len); }
+        size_t print(const char *s) { return write(s); }
+        size_t print(char c) { return write((uint8_t)c); }
+        size_t print(int value, int base = 10) { return print((long)value, base); }
+        size_t print(unsigned int value, int base = 10) { return print((unsigned long)value, base); }
+        size_t print(long value, int base = 10);
+        size_t print(unsigned long value, int base = 10);
+        size_t print(double value, int digits = 2);
+        size_t println() { return write("\r\n"); }
+        template<typename T> size_t println(T value) { return print(value) + println(); }
+        size_t printf(const char *fmt, ...);
+        virtual void flush() {}
+};
+
+class Stream : public Print {
+    public:
+        virtual int available() = 0;
+        virtual int read() = 0;
+};
+
+class HardwareSerial : public Stream {};
+
+
+// receive side of a SERCOM in UART mode, bytes are passed
+// to the interrupt handler one at a time (see sim_arduino.cpp)
+class SERCOM {
+    public:
+        bool availableDataUART() { return rxAvailable; }
+        uint8_t readDataUART() { rxAvailable = false; return rxData; }
+        bool isFrameErrorUART() { return false; }
+        void clearFrameErrorUART() {}
+        uint8_t rxData = 0;
+        bool rxAvailable = false;
+};
+
+extern SERCOM sercom0, sercom1;
+
+
+// UART with transmit time of 10 bits per byte at given baud rate, writes
+// block while more than SIM_UART_TX_BUFFER bytes are in transmission
+class Uart : public HardwareSerial {
+    public:
+        Uart(SERCOM *sercom, uint8_t rx, uint8_t tx, int rxPad, int txPad);
+        void begin(unsigned long baud);
+        void begin(unsigned long baud, uint16_t config) { begin(baud); }
+        int available() { return 0; }
+        int read() { return -1; }
+        size_t write(uint8_t c);
+        using Print::write;
+        void flush();
+        void IrqHandler() {}
+        operator bool() { return true; }
+    private:
+        SERCOM *sercom;
+        uint32_t byteUs = 0;
+        uint64_t txEnd = 0;
+};
+
+extern Uart Serial1;
+
+#define SERIAL_8N1 0x13
+#define SERCOM_RX_PAD_0 0
+#define UART_TX_PAD_2 1
+
+extern "C" void SERCOM1_Handler(void);
+
+
+// registers used by the firmware, writes to NVMCTRL->CTRLA
+// execute the flash command (flash is emulated by RAM)
+typedef struct { volatile uint32_t ICSR, SCR; } SCB_Type;
+#define SCB_SCR_SLEEPDEEP_Msk (1UL << 2)
+#define SCB_ICSR_PENDSTSET_Msk (1UL << 26)
+extern SCB_Type *SCB;
+
+// SysTick counts down from LOAD every millisecond (48 MHz core
+// clock), VAL is derived from virtual time when it is read
+class SysTickValue {
+    public:
+        operator uint32_t() const;
+};
+
+typedef struct {
+    volatile uint32_t LOAD;
+    SysTickValue VAL;
+} SysTick_Type;
+extern SysTick_Type *SysTick;
+
+typedef struct {
+    struct { volatile uint8_t reg; } SLEEP;
+    struct { volatile uint32_t reg; } AHBMASK, APBBMASK;
+} Pm;
+#define PM_SLEEP_IDLE_CPU 0
+#define PM_SLEEP_IDLE_AHB 1
+#define PM_SLEEP_IDLE_APB 2
+extern Pm *PM;
+
+class NvmCommand {
+    public:
+        NvmCommand& operator=(uint16_t cmd);
+};
+
+typedef struct {
+    struct { NvmCommand reg; } CTRLA;
+    struct { struct { uint8_t MANW; } bit; } CTRLB;
+    struct { struct { uint8_t READY; } bit; } INTFLAG;
+    struct { uintptr_t reg; } ADDR;
+} Nvmctrl;
+#define NVMCTRL_CTRLA_CMDEX_KEY 0xA500
+#define NVMCTRL_CTRLA_CMD_ER 0x02
+#define NVMCTRL_CTRLA_CMD_WP 0x04
+#define NVMCTRL_CTRLA_CMD_PBC 0x44
+extern Nvmctrl *NVMCTRL;
+
+// RTC frequency correction changes the rate of the
+// emulated RTC from now on (see sim_rtc.cpp)
+class RtcFreqCorr {
+    public:
+        RtcFreqCorr& operator=(uint8_t value);
+        operator uint8_t() const { return value; }
+    private:
+        uint8_t value = 0;
+};
+
+typedef struct {
+    struct {
+        struct { RtcFreqCorr reg; } FREQCORR;
+        struct { struct { uint8_t SYNCBUSY; } bit; } STATUS;
+    } MODE2;
+} Rtc;
+#define RTC_FREQCORR_SIGN (1 << 7)
+#define RTC_FREQCORR_VALUE(value) ((value) & 0x7F)
+extern Rtc *RTC;
+
+// firmware entry points
+void setup();
+void loop();
+
+#endif
@@ -0,0 +1,62 @@
+/***************************************************************************
+  Copyright (c) 2024 Lars Wessels
+
+  This file is part of the "Feather-M0-LoRaWAN-PM-Sensor" source code.
+  https://github.com/lrswss/feather-m0-lorawan-pm-sensor
+
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+   
+  http://www.apache.org/licenses/LICENSE-2.0
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+***************************************************************************/
+
+// RTC keeps running in standby, standbyMode() advances virtual
+// time until the alarm matches (see sim_rtc.cpp)
+
+#ifndef _SIM_RTCZERO_H
+#define _SIM_RTCZERO_H
+
+#include <stdint.h>
+
+typedef void (*voidFuncPtr)(void);
+
+class RTCZero {
+    public:
+        enum Alarm_Match {
+            MATCH_OFF,
+            MATCH_SS,
+            MATCH_MMSS,
+            MATCH_HHMMSS,
+            MATCH_DHHMMSS,
+            MATCH_MMDDHHMMSS,
+            MATCH_YYMMDDHHMMSS
+        };
+        void begin(bool resetTime = false);
+        uint32_t getEpoch();
+        void setEpoch(uint32_t ts);
+        uint8_t getHours();
+        uint8_t getMinutes();
+        uint8_t getSeconds();
+        void setAlarmEpoch(uint32_t ts);
+        uint8_t getAlarmHours();
+        uint8_t getAlarmMinutes();
+        uint8_t getAlarmSeconds();
+        void enableAlarm(Alarm_Match match);
+        void disableAlarm();
+        void attachInterrupt(voidFuncPtr callback);
+        void standbyMode();
+    private:
+        uint32_t alarm = 0;
+        Alarm_Match match = MATCH_OFF;
+        voidFuncPtr callback = 0;
+};
+
+#endif
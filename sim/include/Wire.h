@@ -0,0 +1,55 @@
+/***************************************************************************
+  Copyright (c) 2024 Lars Wessels
+
+  This file is part of the "Feather-M0-LoRaWAN-PM-Sensor" source code.
+  https://github.com/lrswss/feather-m0-lorawan-pm-sensor
+
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+   
+  http://www.apache.org/licenses/LICENSE-2.0
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+***************************************************************************/
+
+// I2C master, transfers take bus time at the configured clock,
+// addressed devices are emulated by sim_i2c.cpp
+
+#ifndef _SIM_WIRE_H
+#define _SIM_WIRE_H
+
+#include "Arduino.h"
+
+#define SIM_WIRE_BUFFER 32
+
+class TwoWire : public Stream {
+    public:
+        void begin() { clock = 100000; }
+        void setClock(uint32_t hz) { clock = hz; }
+        void beginTransmission(uint8_t addr);
+        uint8_t endTransmission(bool stop = true);
+        uint8_t requestFrom(uint8_t addr, uint8_t len);
+        size_t write(uint8_t c);
+        using Print::write;
+        int available() { return rxLen - rxPos; }
+        int read() { return rxPos < rxLen ? rxBuf[rxPos++] : -1; }
+    private:
+        void transfer(uint8_t bytes);
+        uint32_t clock = 100000;
+        uint8_t txAddr = 0;
+        uint8_t txBuf[SIM_WIRE_BUFFER];
+        uint8_t txLen = 0;
+        uint8_t rxBuf[SIM_WIRE_BUFFER];
+        uint8_t rxLen = 0;
+        uint8_t rxPos = 0;
+};
+
+extern TwoWire Wire;
+
+#endif
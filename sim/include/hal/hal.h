@@ -0,0 +1,40 @@
+/***************************************************************************
+  Copyright (c) 2024 Lars Wessels
+
+  This file is part of the "Feather-M0-LoRaWAN-PM-Sensor" source code.
+  https://github.com/lrswss/feather-m0-lorawan-pm-sensor
+
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+   
+  http://www.apache.org/licenses/LICENSE-2.0
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+***************************************************************************/
+
+#ifndef _SIM_HAL_H
+#define _SIM_HAL_H
+
+#include <stdint.h>
+
+#define LMIC_UNUSED_PIN 0xff
+#define NUM_DIO 3
+
+// pin mapping is defined by the firmware but not used by the emulation
+struct lmic_pinmap {
+    uint8_t nss;
+    uint8_t rxtx;
+    uint8_t rst;
+    uint8_t dio[NUM_DIO];
+    uint8_t rxtx_rx_active;
+    int8_t rssi_cal;
+    uint32_t spi_freq;
+};
+
+#endif
@@ -0,0 +1,191 @@
+/***************************************************************************
+  Copyright (c) 2024 Lars Wessels
+
+  This file is part of the "Feather-M0-LoRaWAN-PM-Sensor" source code.
+  https://github.com/lrswss/feather-m0-lorawan-pm-sensor
+
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+   
+  http://www.apache.org/licenses/LICENSE-2.0
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+***************************************************************************/
+
+// subset of the MCCI LoRaWAN LMIC library API used by the firmware; the OS
+// job queue runs on virtual time, MAC and radio are emulated by sim_lmic.cpp
+// (EU868, OTAA join, (un)confirmed uplinks, DeviceTimeReq)
+
+#ifndef _SIM_LMIC_H
+#define _SIM_LMIC_H
+
+#include <stdint.h>
+
+#define ARDUINO_LMIC_VERSION 0x04010100
+#define ARDUINO_LMIC_VERSION_GET_MAJOR(v) ((unsigned long)(((v) >> 24u) & 0xFFu))
+#define ARDUINO_LMIC_VERSION_GET_MINOR(v) ((unsigned long)(((v) >> 16u) & 0xFFu))
+#define ARDUINO_LMIC_VERSION_GET_PATCH(v) ((unsigned long)(((v) >> 8u) & 0xFFu))
+#define ARDUINO_LMIC_VERSION_GET_LOCAL(v) ((unsigned long)((v) & 0xFFu))
+
+typedef uint8_t bit_t;
+typedef uint8_t u1_t;
+typedef int8_t s1_t;
+typedef uint16_t u2_t;
+typedef int16_t s2_t;
+typedef uint32_t u4_t;
+typedef int32_t s4_t;
+typedef int32_t ostime_t;
+typedef u4_t devaddr_t;
+typedef u1_t dr_t;
+
+// 16 μs per tick (US_PER_OSTICK_EXPONENT 4)
+#define US_PER_OSTICK 16
+#define OSTICKS_PER_SEC (1000000 / US_PER_OSTICK)
+#define ms2osticks(ms) ((ostime_t)(((int64_t)(ms) * OSTICKS_PER_SEC) / 1000))
+#define sec2osticks(sec) ((ostime_t)((int64_t)(sec) * OSTICKS_PER_SEC))
+#define osticks2ms(os) ((s4_t)(((os) * (int64_t)1000) / OSTICKS_PER_SEC))
+#define us2osticks(us) ((ostime_t)(((int64_t)(us) * OSTICKS_PER_SEC) / 1000000))
+
+struct osjob_t;
+typedef void (*osjobcb_t)(struct osjob_t *);
+struct osjob_t {
+    struct osjob_t *next;
+    ostime_t deadline;
+    osjobcb_t func;
+};
+typedef struct osjob_t osjob_t;
+
+enum _ev_t {
+    EV_SCAN_TIMEOUT = 1, EV_BEACON_FOUND, EV_BEACON_MISSED, EV_BEACON_TRACKED,
+    EV_JOINING, EV_JOINED, EV_RFU1, EV_JOIN_FAILED, EV_REJOIN_FAILED, EV_TXCOMPLETE,
+    EV_LOST_TSYNC, EV_RESET, EV_RXCOMPLETE, EV_LINK_DEAD, EV_LINK_ALIVE, EV_SCAN_FOUND,
+    EV_TXSTART, EV_TXCANCELED, EV_RXSTART, EV_JOIN_TXCOMPLETE
+};
+typedef enum _ev_t ev_t;
+
+enum _dr_eu868_t { DR_SF12 = 0, DR_SF11, DR_SF10, DR_SF9, DR_SF8, DR_SF7, DR_SF7B, DR_FSK, DR_NONE };
+
+enum {
+    OP_NONE = 0x0000, OP_SCAN = 0x0001, OP_TRACK = 0x0002, OP_JOINING = 0x0004,
+    OP_TXDATA = 0x0008, OP_POLL = 0x0010, OP_REJOIN = 0x0020, OP_SHUTDOWN = 0x0040,
+    OP_TXRXPEND = 0x0080, OP_RNDTX = 0x0100, OP_PINGINI = 0x0200, OP_PINGABLE = 0x0400,
+    OP_NEXTCHNL = 0x0800, OP_LINKDEAD = 0x1000, OP_TESTMODE = 0x2000, OP_UNJOIN = 0x4000
+};
+
+enum {
+    TXRX_ACK = 0x80, TXRX_NACK = 0x40, TXRX_NOPORT = 0x20, TXRX_PORT = 0x10,
+    TXRX_LENRDY = 0x08, TXRX_PING = 0x04, TXRX_DNW2 = 0x02, TXRX_DNW1 = 0x01
+};
+
+#define RSSI_OFF 64
+#define DELAY_JACC1 5
+#define LEN_JA 17
+#define MAX_CLOCK_ERROR 65536
+#define MAX_CHANNELS 16
+#define MAX_BANDS 4
+#define CFG_LMIC_EU_like 1
+#define MAX_LEN_FRAME 64
+#define KEEP_TXPOW -128
+#define MCMD_DEVS_EXT_POWER 0x00
+#define MCMD_DEVS_BATT_MIN 0x01
+#define MCMD_DEVS_BATT_MAX 0xFE
+#define MCMD_DEVS_BATT_NOINFO 0xFF
+
+// link check (LinkCheckMode): uplinks without downlink are counted from
+// LINK_CHECK_INIT, EV_LINK_DEAD is reported when LINK_CHECK_DEAD is reached
+enum { LINK_CHECK_CONT = 0, LINK_CHECK_DEAD = 32, LINK_CHECK_INIT = -64, LINK_CHECK_OFF = -128 };
+
+#define LMIC_ERROR_SUCCESS 0
+#define LMIC_ERROR_TX_BUSY -1
+#define LMIC_ERROR_TX_TOO_LARGE -2
+
+typedef struct {
+    u2_t txcap; // duty cycle limitation: 1/txcap
+    s1_t txpow;
+    u1_t lastchnl;
+    ostime_t avail; // band is blocked until this time
+} band_t;
+
+struct lmic_t {
+    u4_t netid;
+    devaddr_t devaddr;
+    u1_t nwkKey[16];
+    u1_t artKey[16];
+    u4_t seqnoUp;
+    u4_t seqnoDn;
+    u4_t freq;
+    u2_t opmode;
+    dr_t datarate;
+    s1_t adrTxPow;
+    s1_t txpow;
+    u1_t txCnt;
+    u1_t txrxFlags;
+    u1_t dataBeg;
+    u1_t dataLen;
+    u1_t frame[MAX_LEN_FRAME];
+    u1_t pendTxPort;
+    u1_t pendTxConf;
+    u1_t pendTxLen;
+    u1_t pendTxData[MAX_LEN_FRAME - 13]; // MAX_LEN_PAYLOAD
+    u1_t pendMacLen;
+    s1_t rssi;
+    s1_t snr;
+    band_t bands[MAX_BANDS];
+    ostime_t globalDutyAvail;
+    u4_t channelFreq[MAX_CHANNELS];
+    u2_t channelDrMap[MAX_CHANNELS];
+    u2_t channelMap;
+    u2_t devNonce;
+    u1_t rxDelay;
+    u1_t rx1DrOffset;
+    dr_t dn2Dr;
+    u4_t dn2Freq;
+    u1_t adrEnabled;
+    s1_t adrAckReq;
+    u2_t clockError;
+    u1_t netDeviceTimeFrac; // 1/256 secs
+};
+typedef struct lmic_t lmic_t;
+extern lmic_t LMIC;
+
+typedef struct {
+    ostime_t tLocal;
+    u4_t tNetwork;
+} lmic_time_reference_t;
+typedef void lmic_request_network_time_cb_t(void *pUserData, int flagSuccess);
+
+void os_init();
+ostime_t os_getTime();
+void os_runloop_once();
+void os_setCallback(osjob_t *job, osjobcb_t cb);
+void os_setTimedCallback(osjob_t *job, ostime_t time, osjobcb_t cb);
+void os_clearCallback(osjob_t *job);
+bit_t os_jobIsTimed(osjob_t *job);
+bit_t os_queryTimeCriticalJobs(ostime_t time);
+
+void LMIC_reset();
+void LMIC_setClockError(u2_t error);
+bit_t LMIC_startJoining();
+int LMIC_setTxData2(u1_t port, u1_t *data, u1_t dlen, u1_t confirmed);
+void LMIC_clrTxData();
+void LMIC_setAdrMode(bit_t enabled);
+void LMIC_setLinkCheckMode(bit_t enabled);
+void LMIC_setSession(u4_t netid, devaddr_t devaddr, const u1_t *nwkKey, const u1_t *artKey);
+void LMIC_setDrTxpow(dr_t dr, s1_t txpow);
+void LMIC_requestNetworkTime(lmic_request_network_time_cb_t *callback, void *pUserData);
+int LMIC_getNetworkTimeReference(lmic_time_reference_t *ref);
+
+// provided by the firmware
+void onEvent(ev_t ev);
+void os_getDevEui(u1_t *buf);
+void os_getArtEui(u1_t *buf);
+void os_getDevKey(u1_t *buf);
+u1_t os_getBattLevel(void);
+
+#endif
@@ -0,0 +1,131 @@
+/***************************************************************************
+  Copyright (c) 2024 Lars Wessels
+
+  This file is part of the "Feather-M0-LoRaWAN-PM-Sensor" source code.
+  https://github.com/lrswss/feather-m0-lorawan-pm-sensor
+
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+   
+  http://www.apache.org/licenses/LICENSE-2.0
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+***************************************************************************/
+
+// Host-side simulator: the unmodified firmware (src/) runs against the shims
+// in sim/include in accelerated virtual time. SDS011, I2C sensors, battery
+// and LoRaWAN network are emulated, the energy model integrates the current
+// of MCU, SDS011, LED and radio and prints a report for each observation
+// cycle (see README, build with "pio run -e native")
+
+#ifndef _SIM_H
+#define _SIM_H
+
+#include <stdint.h>
+
+// estimated battery currents (mA), adjust to measurements of your node
+#define SIM_MCU_ACTIVE_MA 11.0   // SAMD21 at 48 MHz, board regulator
+#define SIM_MCU_IDLE_MA 4.5      // idle mode (WFI), clocks running
+#define SIM_MCU_STANDBY_MA 0.3   // standby, RTC running, radio asleep
+#define SIM_SDS011_ON_MA 110.0   // fan and laser diode (incl. boost converter)
+#define SIM_SDS011_SLEEP_MA 4.5  // SDS011 in sleep mode
+#define SIM_RADIO_TX_MA 44.0     // RFM95 transmitting at 14 dBm
+#define SIM_RADIO_RX_MA 11.5     // RFM95 receive window
+#define SIM_LED_MA 1.0           // red LED on D13
+
+// MCU time consumed per clock read (millis(), micros(), os_getTime())
+#define SIM_CLOCK_READ_US 2
+// bytes buffered by Uart before write() blocks
+#define SIM_UART_TX_BUFFER 64
+// standby of at least given seconds ends an observation cycle in the report
+#define SIM_CYCLE_SLEEP_SECS 60
+// RTC (and simulated UTC) at start, 2000-01-01 until set by network time
+#define SIM_RTC_START 946684800UL
+#define SIM_UTC_START 1717200000UL  // 2024-06-01 00:00 UTC
+
+typedef enum {
+    SIM_ACTIVE,
+    SIM_IDLE,
+    SIM_STANDBY
+} simMcuState_t;
+
+typedef enum {
+    SIM_RADIO_SLEEP,
+    SIM_RADIO_TX,
+    SIM_RADIO_RX
+} simRadioState_t;
+
+typedef enum {
+    SIM_SENSOR_NONE,
+    SIM_SENSOR_BME280,
+    SIM_SENSOR_SHT31,
+    SIM_SENSOR_SI7021
+} simSensor_t;
+
+typedef struct {
+    double hours;         // simulated time
+    uint32_t seed;
+    double capacity;      // battery capacity (mAh)
+    double soc;           // state of charge at start (%)
+    double pm25;          // mean PM2.5 (μg/m3)
+    double eventStart;    // PM event (hours after start, length, PM2.5)
+    double eventHours;
+    double eventPm25;
+    simSensor_t sensor;
+    uint8_t sf;           // spreading factor after join (ADR result)
+    double rtcPpm;        // RTC crystal error, positive if RTC runs fast
+    double sdsLoss;       // SDS011 data frames lost (%)
+    int32_t joinFail;     // failing join attempts, -1 if network is unreachable
+    double dlLoss;        // downlinks (e.g. ACKs) lost after join (%)
+    double downlinkAt;    // application downlink after hours, -1 if none
+    uint8_t downlinkPort;
+    uint8_t downlinkLen;
+    uint8_t downlink[51];
+    bool log;             // firmware serial output to stderr
+    bool quiet;           // summary only, no report per cycle
+} simOptions_t;
+
+extern simOptions_t simOptions;
+
+// virtual time (μs), wall clock and SysTick (stopped in standby)
+uint64_t sim_now();
+uint64_t sim_ticks();
+uint64_t sim_clock_read();
+void sim_advance(uint64_t us, simMcuState_t state);
+void sim_warn(const char *fmt, ...);
+double sim_random();
+
+// environment at given wall clock time
+double sim_env_pm25(uint64_t us);
+double sim_env_temperature(uint64_t us);
+double sim_env_humidity(uint64_t us);
+double sim_env_pressure(uint64_t us);
+
+// emulated devices
+void sim_sds011_receive(uint8_t c, uint64_t at);
+uint64_t sim_sds011_next();
+void sim_sds011_update(uint64_t now, bool deliver);
+bool sim_sds011_running();
+void sim_uart_receive(uint8_t c);
+bool sim_i2c_present(uint8_t addr);
+void sim_i2c_write(uint8_t addr, const uint8_t *buf, uint8_t len);
+uint8_t sim_i2c_read(uint8_t addr, uint8_t *buf, uint8_t len);
+
+// energy model and report
+void sim_radio(simRadioState_t state, uint64_t start, uint64_t us);
+uint64_t sim_radio_next(uint64_t now);
+void sim_led(bool on);
+void sim_energy_add(uint64_t us, simMcuState_t state);
+void sim_energy_standby(uint64_t us);
+void sim_energy_uplink(bool join);
+double sim_battery_mv();
+void sim_report_header();
+void sim_report_finish();
+
+#endif
@@ -0,0 +1,174 @@
+/***************************************************************************
+  Copyright (c) 2024 Lars Wessels
+
+  This file is part of the "Feather-M0-LoRaWAN-PM-Sensor" source code.
+  https://github.com/lrswss/feather-m0-lorawan-pm-sensor
+
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+   
+  http://www.apache.org/licenses/LICENSE-2.0
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+***************************************************************************/
+
+#include "Arduino.h"
+#include "sim.h"
+
+SERCOM sercom0, sercom1;
+Uart Serial1(&sercom0, 0, 1, SERCOM_RX_PAD_0, UART_TX_PAD_2);
+
+static SCB_Type scb;
+static SysTick_Type sysTick = { F_CPU / 1000 - 1, {} };
+static Pm pm;
+static Nvmctrl nvmctrl = { {}, {}, { { 1 } }, { 0 } };
+SCB_Type *SCB = &scb;
+SysTick_Type *SysTick = &sysTick;
+Pm *PM = &pm;
+Nvmctrl *NVMCTRL = &nvmctrl;
+
+static int adcBits = 10;
+
+
+size_t Print::write(const uint8_t *buf, size_t len) {
+    for (size_t i = 0; i < len; i++)
+        write(buf[i]);
+    return len;
+}
+
+
+size_t Print::print(long value, int base) {
+    char buf[34];
+
+    snprintf(buf, sizeof(buf), base == 16 ? "%lX" : "%ld", value);
+    return write(buf);
+}
+
+
+size_t Print::print(unsigned long value, int base) {
+    char buf[34];
+
+    snprintf(buf, sizeof(buf), base == 16 ? "%lX" : "%lu", value);
+    return write(buf);
+}
+
+
+size_t Print::print(double value, int digits) {
+    char buf[32];
+
+    snprintf(buf, sizeof(buf), "%.*f", digits, value);
+    return write(buf);
+}
+
+
+size_t Print::printf(const char *fmt, ...) {
+    char buf[256];
+    va_list args;
+
+    va_start(args, fmt);
+    vsnprintf(buf, sizeof(buf), fmt, args);
+    va_end(args);
+    return write(buf);
+}
+
+
+Uart::Uart(SERCOM *sercom, uint8_t rx, uint8_t tx, int rxPad, int txPad) {
+    this->sercom = sercom;
+}
+
+
+void Uart::begin(unsigned long baud) {
+    byteUs = 10000000UL / baud; // start, 8 data and stop bit
+}
+
+
+// queue byte for transmission, Serial1 output (log messages) is
+// copied to stderr, bytes sent to SDS011 are received by its emulation
+size_t Uart::write(uint8_t c) {
+    uint64_t limit = SIM_UART_TX_BUFFER * (uint64_t)byteUs;
+
+    if (byteUs == 0)
+        return 0;
+    if (txEnd > sim_now() + limit)
+        sim_advance(txEnd - limit - sim_now(), SIM_ACTIVE);
+    txEnd = max(txEnd, sim_now()) + byteUs;
+
+    if (sercom == &sercom1)
+        sim_sds011_receive(c, txEnd);
+    else if (simOptions.log && c != '\r')
+        fputc(c, stderr);
+    return 1;
+}
+
+
+// wait until all bytes have been transmitted
+void Uart::flush() {
+    if (txEnd > sim_now())
+        sim_advance(txEnd - sim_now(), SIM_ACTIVE);
+}
+
+
+// byte received by SERCOM1 (SDS011), run interrupt handler
+void sim_uart_receive(uint8_t c) {
+    sercom1.rxData = c;
+    sercom1.rxAvailable = true;
+    SERCOM1_Handler();
+}
+
+
+// execute flash command, waiting for its completion keeps the MCU
+// active (row erase 6 ms, page write 2.5 ms, SAMD21 datasheet)
+NvmCommand& NvmCommand::operator=(uint16_t cmd) {
+    switch (cmd & 0x7F) {
+        case NVMCTRL_CTRLA_CMD_ER:
+            memset((void *)(NVMCTRL->ADDR.reg * 2), 0xFF, 256);
+            sim_advance(6000, SIM_ACTIVE);
+            break;
+        case NVMCTRL_CTRLA_CMD_WP:
+            sim_advance(2500, SIM_ACTIVE);
+            break;
+    }
+    return *this;
+}
+
+
+void pinMode(uint32_t pin, uint32_t mode) {}
+
+
+void digitalWrite(uint32_t pin, uint32_t value) {
+    if (pin == LED_BUILTIN)
+        sim_led(value == HIGH);
+}
+
+
+void analogReadResolution(int bits) {
+    adcBits = bits;
+}
+
+
+// battery voltage on A7 (voltage divider 1:2, 3.3V reference) with
+// some noise, conversion takes about 400 μs with Arduino core defaults
+int analogRead(uint32_t pin) {
+    double mv;
+
+    sim_advance(400, SIM_ACTIVE);
+    if (pin != A7)
+        return 0;
+    mv = sim_battery_mv() / 2 + (sim_random() - 0.5) * 4;
+    return constrain(lround(mv * (1 << adcBits) / 3300), 0L, (1L << adcBits) - 1);
+}
+
+
+char *itoa(int value, char *buf, int base) {
+    if (base == 16)
+        sprintf(buf, "%X", (unsigned)value);
+    else
+        sprintf(buf, "%d", value);
+    return buf;
+}
@@ -0,0 +1,139 @@
+/***************************************************************************
+  Copyright (c) 2024 Lars Wessels
+
+  This file is part of the "Feather-M0-LoRaWAN-PM-Sensor" source code.
+  https://github.com/lrswss/feather-m0-lorawan-pm-sensor
+
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+   
+  http://www.apache.org/licenses/LICENSE-2.0
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+***************************************************************************/
+
+#include "Arduino.h"
+#include "sim.h"
+
+// virtual wall clock and SysTick time (μs), SysTick is stopped in standby
+static uint64_t nowUs = 0;
+static uint64_t tickUs = 0;
+static uint64_t endUs = 0;
+
+
+uint64_t sim_now() {
+    return nowUs;
+}
+
+
+uint64_t sim_ticks() {
+    return tickUs;
+}
+
+
+// SysTick time after reading the clock, which takes some time, so
+// firmware polling a clock in a busy loop still makes progress
+uint64_t sim_clock_read() {
+    sim_advance(SIM_CLOCK_READ_US, SIM_ACTIVE);
+    return tickUs;
+}
+
+
+// advance virtual time by given number of μs with MCU in given state;
+// bytes sent by the SDS011 meanwhile are passed to the SERCOM1 interrupt
+// handler (dropped in standby), simulation ends at given number of hours
+void sim_advance(uint64_t us, simMcuState_t state) {
+    uint64_t end = nowUs + us, next;
+
+    if (endUs == 0)
+        endUs = simOptions.hours * 3600e6;
+    do {
+        next = min(min(end, endUs), sim_radio_next(nowUs));
+        if (state != SIM_STANDBY)
+            next = min(next, max(sim_sds011_next(), nowUs));
+        sim_energy_add(next - nowUs, state);
+        if (state != SIM_STANDBY)
+            tickUs += next - nowUs;
+        nowUs = next;
+        sim_sds011_update(nowUs, state != SIM_STANDBY);
+        if (nowUs >= endUs) {
+            sim_report_finish();
+            exit(0);
+        }
+    } while (nowUs < end);
+}
+
+
+uint32_t millis() {
+    return sim_clock_read() / 1000;
+}
+
+
+uint32_t micros() {
+    return sim_clock_read();
+}
+
+
+// SysTick wraps with each millisecond, SysTick interrupt (millis())
+// is never pending since time only advances when the clock is read
+SysTickValue::operator uint32_t() const {
+    return SysTick->LOAD - (tickUs % 1000) * (SysTick->LOAD + 1) / 1000;
+}
+
+
+// busy waiting, MCU stays active
+void delay(uint32_t ms) {
+    sim_advance(ms * 1000ULL, SIM_ACTIVE);
+}
+
+
+void delayMicroseconds(uint32_t us) {
+    sim_advance(us, SIM_ACTIVE);
+}
+
+
+// idle mode until next interrupt, which is either the next
+// SysTick (1 ms) or a byte received from the SDS011
+void __WFI() {
+    uint64_t us = 1000 - tickUs % 1000, next = sim_sds011_next();
+
+    if (next > nowUs && next - nowUs < us)
+        us = next - nowUs;
+    sim_advance(us, SIM_IDLE);
+}
+
+
+void __DSB() {}
+void noInterrupts() {}
+void interrupts() {}
+
+
+void sim_warn(const char *fmt, ...) {
+    va_list args;
+    uint32_t secs = nowUs / 1000000;
+
+    fprintf(stderr, "[sim %02u:%02u:%02u] ", secs / 3600, (secs / 60) % 60, secs % 60);
+    va_start(args, fmt);
+    vfprintf(stderr, fmt, args);
+    va_end(args);
+    fputc('\n', stderr);
+}
+
+
+// uniformly distributed in [0, 1) (xorshift64*)
+double sim_random() {
+    static uint64_t state = 0;
+
+    if (state == 0)
+        state = 0x9E3779B97F4A7C15ULL ^ simOptions.seed;
+    state ^= state >> 12;
+    state ^= state << 25;
+    state ^= state >> 27;
+    return ((state * 0x2545F4914F6CDD1DULL) >> 11) * (1.0 / 9007199254740992.0);
+}
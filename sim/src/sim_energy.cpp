@@ -0,0 +1,204 @@
+/***************************************************************************
+  Copyright (c) 2024 Lars Wessels
+
+  This file is part of the "Feather-M0-LoRaWAN-PM-Sensor" source code.
+  https://github.com/lrswss/feather-m0-lorawan-pm-sensor
+
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+   
+  http://www.apache.org/licenses/LICENSE-2.0
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+***************************************************************************/
+
+#include "Arduino.h"
+#include "sim.h"
+
+#define RADIO_WINDOWS 8
+#define BATTERY_RESISTANCE 0.15 // internal resistance (Ω), voltage drop under load
+
+typedef struct {
+    uint64_t us;
+    uint64_t awakeUs;
+    uint64_t fanUs;
+    uint64_t txUs;
+    uint64_t rxUs;
+    double charge; // mA * μs
+    uint16_t uplinks;
+    uint16_t joins;
+} simUsage_t;
+
+static simUsage_t cycle, total;
+static uint64_t cycleStart = 0;
+static uint32_t cycles = 0;
+static double lastCurrent = 0;
+static bool led = false;
+
+// scheduled radio activity (wall clock)
+static struct {
+    uint64_t start;
+    uint64_t end;
+    simRadioState_t state;
+} radio[RADIO_WINDOWS];
+static uint8_t radioCount = 0;
+
+// open circuit voltage (mV) of Li-Ion cell at 0, 10, ..., 100 % charge
+static const double ocvCurve[] = {
+    3300, 3690, 3730, 3770, 3800, 3840, 3870, 3950, 4020, 4110, 4200
+};
+
+
+// add radio activity (TX or RX window) starting at given time, expired
+// entries are removed; energy model splits time steps at their bounds
+void sim_radio(simRadioState_t state, uint64_t start, uint64_t us) {
+    uint8_t i, n = 0;
+
+    for (i = 0; i < radioCount; i++) {
+        if (radio[i].end > sim_now())
+            radio[n++] = radio[i];
+    }
+    radioCount = n;
+    if (radioCount == RADIO_WINDOWS) {
+        sim_warn("Too many radio windows");
+        return;
+    }
+    radio[radioCount].start = start;
+    radio[radioCount].end = start + us;
+    radio[radioCount].state = state;
+    radioCount++;
+}
+
+
+// next start or end of radio activity after given time
+uint64_t sim_radio_next(uint64_t now) {
+    uint64_t next = UINT64_MAX;
+
+    for (uint8_t i = 0; i < radioCount; i++) {
+        if (radio[i].start > now)
+            next = min(next, radio[i].start);
+        else if (radio[i].end > now)
+            next = min(next, radio[i].end);
+    }
+    return next;
+}
+
+
+static simRadioState_t radio_state(uint64_t now) {
+    for (uint8_t i = 0; i < radioCount; i++) {
+        if (radio[i].start <= now && now < radio[i].end)
+            return radio[i].state;
+    }
+    return SIM_RADIO_SLEEP;
+}
+
+
+void sim_led(bool on) {
+    led = on;
+}
+
+
+static void usage_add(simUsage_t *usage, uint64_t us, simMcuState_t state,
+        simRadioState_t radio, double current) {
+    usage->us += us;
+    if (state != SIM_STANDBY)
+        usage->awakeUs += us;
+    if (sim_sds011_running())
+        usage->fanUs += us;
+    if (radio == SIM_RADIO_TX)
+        usage->txUs += us;
+    else if (radio == SIM_RADIO_RX)
+        usage->rxUs += us;
+    usage->charge += current * us;
+}
+
+
+// integrate battery current for given time with MCU in given state
+// (state of devices is constant within a time step)
+void sim_energy_add(uint64_t us, simMcuState_t state) {
+    simRadioState_t radio = radio_state(sim_now());
+    double current;
+
+    if (us == 0)
+        return;
+    current = state == SIM_ACTIVE ? SIM_MCU_ACTIVE_MA : state == SIM_IDLE ? SIM_MCU_IDLE_MA : SIM_MCU_STANDBY_MA;
+    current += sim_sds011_running() ? SIM_SDS011_ON_MA : SIM_SDS011_SLEEP_MA;
+    current += radio == SIM_RADIO_TX ? SIM_RADIO_TX_MA : radio == SIM_RADIO_RX ? SIM_RADIO_RX_MA : 0;
+    current += led ? SIM_LED_MA : 0;
+    usage_add(&cycle, us, state, radio, current);
+    usage_add(&total, us, state, radio, current);
+    lastCurrent = current;
+}
+
+
+void sim_energy_uplink(bool join) {
+    cycle.uplinks++;
+    total.uplinks++;
+    if (join) {
+        cycle.joins++;
+        total.joins++;
+    }
+}
+
+
+// battery voltage from state of charge (open circuit voltage)
+// and voltage drop caused by the current drawn last
+double sim_battery_mv() {
+    static bool empty = false;
+    double soc = simOptions.soc - total.charge / 3.6e9 / simOptions.capacity * 100;
+    uint8_t i;
+
+    if (soc <= 0) {
+        if (!empty)
+            sim_warn("Battery empty");
+        empty = true;
+        return ocvCurve[0] - 300;
+    }
+    i = min((int)(soc / 10), 9);
+    return ocvCurve[i] + (ocvCurve[i + 1] - ocvCurve[i]) * (soc - i * 10) / 10
+        - lastCurrent * BATTERY_RESISTANCE;
+}
+
+
+void sim_report_header() {
+    if (simOptions.quiet)
+        return;
+    printf("cycle     start  length_s  awake_ms   fan_ms   tx_ms   rx_ms  tx  charge_mAh  avg_mA  vbat_mV\n");
+}
+
+
+// standby of given length has ended, a long one closes current cycle
+void sim_energy_standby(uint64_t us) {
+    uint32_t start = cycleStart / 1000000;
+
+    if (us < SIM_CYCLE_SLEEP_SECS * 1000000ULL)
+        return;
+    cycles++;
+    if (!simOptions.quiet)
+        printf("%5u  %02u:%02u:%02u  %8.1f  %8.0f  %7.0f  %6.0f  %6.0f  %2u  %10.4f  %6.3f  %7.0f\n",
+            cycles, start / 3600, (start / 60) % 60, start % 60, cycle.us / 1e6,
+            cycle.awakeUs / 1e3, cycle.fanUs / 1e3, cycle.txUs / 1e3, cycle.rxUs / 1e3,
+            cycle.uplinks, cycle.charge / 3.6e9, cycle.charge / cycle.us, sim_battery_mv());
+    memset(&cycle, 0, sizeof(cycle));
+    cycleStart = sim_now();
+}
+
+
+void sim_report_finish() {
+    double hours = total.us / 3.6e9, avg = total.charge / max(total.us, 1ULL);
+
+    printf("\nSimulated %.1f h: %u cycles, %u uplinks (%u join requests)\n",
+        hours, cycles, total.uplinks, total.joins);
+    printf("Awake %.2f%%, SDS011 fan %.2f%%, radio TX %.3f%%, RX %.3f%%\n",
+        100.0 * total.awakeUs / total.us, 100.0 * total.fanUs / total.us,
+        100.0 * total.txUs / total.us, 100.0 * total.rxUs / total.us);
+    printf("Charge %.1f mAh, average current %.3f mA\n", total.charge / 3.6e9, avg);
+    printf("Estimated runtime on %.0f mAh battery (%.0f%% charged): %.1f days\n",
+        simOptions.capacity, simOptions.soc, simOptions.capacity * simOptions.soc / 100 / avg / 24);
+}
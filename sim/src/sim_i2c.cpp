@@ -0,0 +1,382 @@
+/***************************************************************************
+  Copyright (c) 2024 Lars Wessels
+
+  This file is part of the "Feather-M0-LoRaWAN-PM-Sensor" source code.
+  https://github.com/lrswss/feather-m0-lorawan-pm-sensor
+
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+   
+  http://www.apache.org/licenses/LICENSE-2.0
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+***************************************************************************/
+
+#include "Arduino.h"
+#include "Wire.h"
+#include "Adafruit_BME280.h"
+#include "Adafruit_SHT31.h"
+#include "Adafruit_Si7021.h"
+#include "sim.h"
+
+// emulated temperature/humidity sensor (one of BME280, SHT31, Si7021),
+// results are only available after the conversion time of the sensor
+#define BME280_SIM_ADDR 0x76
+#define BME280_CONV_US 9300   // forced mode, 1x oversampling
+#define SHT31_CONV_US 12500   // single shot, high repeatability (typ.)
+#define SI7021_CONV_US 22800  // humidity 12 bit and temperature 14 bit
+#define SI7021_TEMP_US 10800  // temperature 14 bit
+
+TwoWire Wire;
+
+// BME280: values of last completed conversion (NAN before first one)
+static uint8_t bmeMode = Adafruit_BME280::MODE_SLEEP;
+static bool bmeConverting = false;
+static uint64_t bmeDone = 0;
+static double bmeTemp = NAN, bmeHum = NAN, bmePres = NAN;
+
+// SHT31 and Si7021: measurement in progress or result ready to be read
+static bool shtData = false;
+static uint64_t shtDone = 0;
+static bool siData = false;
+static bool siTemp = false;
+static uint8_t siCmd = 0;
+static uint64_t siDone = 0;
+static uint64_t siTempTime = 0;
+
+
+static uint8_t i2c_sensor_addr() {
+    switch (simOptions.sensor) {
+        case SIM_SENSOR_BME280: return BME280_SIM_ADDR;
+        case SIM_SENSOR_SHT31: return SHT31_DEFAULT_ADDR;
+        case SIM_SENSOR_SI7021: return SI7021_DEFAULT_ADDRESS;
+        default: return 0;
+    }
+}
+
+
+bool sim_i2c_present(uint8_t addr) {
+    return addr != 0 && addr == i2c_sensor_addr();
+}
+
+
+// 16 bit big endian value with CRC-8 (polynomial 0x31)
+static void i2c_word(uint8_t *buf, uint16_t value, uint8_t crc) {
+    buf[0] = value >> 8;
+    buf[1] = value & 0xFF;
+    for (uint8_t i = 0; i < 2; i++) {
+        crc ^= buf[i];
+        for (uint8_t j = 0; j < 8; j++)
+            crc = (crc & 0x80) ? (crc << 1) ^ 0x31 : (crc << 1);
+    }
+    buf[2] = crc;
+}
+
+
+// command or register write from MCU
+void sim_i2c_write(uint8_t addr, const uint8_t *buf, uint8_t len) {
+    uint16_t cmd = len >= 2 ? buf[0] << 8 | buf[1] : buf[0];
+
+    if (len == 0)
+        return;
+    if (addr == BME280_SIM_ADDR && len >= 2 && buf[0] == 0xF4) { // ctrl_meas
+        bmeMode = buf[1] & 0x03;
+        if (bmeMode == Adafruit_BME280::MODE_FORCED || bmeMode == 2) {
+            bmeConverting = true;
+            bmeDone = sim_now() + BME280_CONV_US;
+        }
+    } else if (addr == SHT31_DEFAULT_ADDR) {
+        if (cmd == 0x2400) {
+            shtData = true;
+            shtDone = sim_now() + SHT31_CONV_US;
+        } else if (cmd == 0x30A2) {
+            shtData = false;
+        }
+    } else if (addr == SI7021_DEFAULT_ADDRESS) {
+        siTemp = (buf[0] == 0xE0);
+        if (buf[0] == 0xF5 || buf[0] == 0xF3) {
+            siData = true;
+            siCmd = buf[0];
+            siDone = sim_now() + (buf[0] == 0xF5 ? SI7021_CONV_US : SI7021_TEMP_US);
+            siTempTime = siDone;
+        } else if (buf[0] == 0xFE) {
+            siData = false;
+        }
+    }
+}
+
+
+// read result from MCU, returns number of bytes sent or 0 if
+// the device doesn't acknowledge (measurement not finished)
+uint8_t sim_i2c_read(uint8_t addr, uint8_t *buf, uint8_t len) {
+    uint8_t data[6];
+    uint64_t now = sim_now();
+
+    if (addr == SHT31_DEFAULT_ADDR) {
+        if (!shtData || now < shtDone)
+            return 0;
+        shtData = false;
+        i2c_word(data, lround((sim_env_temperature(shtDone) + 45) * 65535 / 175), 0xFF);
+        i2c_word(data + 3, lround(sim_env_humidity(shtDone) * 65535 / 100), 0xFF);
+    } else if (addr == SI7021_DEFAULT_ADDRESS && siTemp) {
+        i2c_word(data, lround((sim_env_temperature(siTempTime) + 46.85) * 65536 / 175.72), 0x00);
+    } else if (addr == SI7021_DEFAULT_ADDRESS) {
+        if (!siData || now < siDone)
+            return 0;
+        siData = false;
+        if (siCmd == 0xF3)
+            i2c_word(data, lround((sim_env_temperature(siDone) + 46.85) * 65536 / 175.72), 0x00);
+        else
+            i2c_word(data, lround((sim_env_humidity(siDone) + 6) * 65536 / 125), 0x00);
+    } else {
+        return 0;
+    }
+    len = min(len, (uint8_t)sizeof(data));
+    memcpy(buf, data, len);
+    return len;
+}
+
+
+// bus time for given number of bytes (9 clocks each) including start/stop
+void TwoWire::transfer(uint8_t bytes) {
+    sim_advance(bytes * 9000000ULL / clock + 10, SIM_ACTIVE);
+}
+
+
+void TwoWire::beginTransmission(uint8_t addr) {
+    txAddr = addr;
+    txLen = 0;
+}
+
+
+size_t TwoWire::write(uint8_t c) {
+    if (txLen >= SIM_WIRE_BUFFER)
+        return 0;
+    txBuf[txLen++] = c;
+    return 1;
+}
+
+
+// returns 0 on success, 2 if address was not acknowledged
+uint8_t TwoWire::endTransmission(bool stop) {
+    if (!sim_i2c_present(txAddr)) {
+        transfer(1);
+        return 2;
+    }
+    transfer(1 + txLen);
+    sim_i2c_write(txAddr, txBuf, txLen);
+    return 0;
+}
+
+
+uint8_t TwoWire::requestFrom(uint8_t addr, uint8_t len) {
+    rxPos = 0;
+    rxLen = sim_i2c_present(addr) ? sim_i2c_read(addr, rxBuf, min(len, (uint8_t)SIM_WIRE_BUFFER)) : 0;
+    transfer(1 + rxLen);
+    return rxLen;
+}
+
+
+// latch result of finished conversion, in normal mode results are always
+// current; warns about reads while a conversion is still running
+static void bme280_update(bool reading) {
+    uint64_t now = sim_now();
+
+    if (bmeMode == Adafruit_BME280::MODE_NORMAL) {
+        bmeConverting = false;
+        bmeDone = now;
+    } else if (!bmeConverting) {
+        return;
+    } else if (now < bmeDone) {
+        if (reading)
+            sim_warn("BME280: read while conversion is running, got previous values");
+        return;
+    }
+    bmeConverting = false;
+    bmeTemp = sim_env_temperature(bmeDone);
+    bmeHum = sim_env_humidity(bmeDone);
+    bmePres = sim_env_pressure(bmeDone);
+}
+
+
+bool Adafruit_BME280::begin(uint8_t addr, TwoWire *wire) {
+    this->addr = addr;
+    this->wire = wire;
+    wire->begin();
+    if (addr != BME280_SIM_ADDR || !sim_i2c_present(addr))
+        return false;
+    delay(10); // soft reset, NVM copy
+    setSampling();
+    delay(100);
+    return true;
+}
+
+
+uint32_t Adafruit_BME280::sensorID() {
+    return 0x60;
+}
+
+
+void Adafruit_BME280::setSampling(sensor_mode mode, sensor_sampling tempSampling,
+        sensor_sampling pressSampling, sensor_sampling humSampling,
+        sensor_filter filter, standby_duration duration) {
+    wire->beginTransmission(addr);
+    wire->write((uint8_t)0xF4);
+    wire->write((uint8_t)(tempSampling << 5 | pressSampling << 2 | mode));
+    wire->endTransmission();
+}
+
+
+bool Adafruit_BME280::takeForcedMeasurement() {
+    setSampling(MODE_FORCED);
+    while (bmeConverting && sim_now() < bmeDone)
+        delay(1);
+    return true;
+}
+
+
+float Adafruit_BME280::readTemperature() {
+    wire->requestFrom(addr, 3);
+    bme280_update(true);
+    return bmeTemp;
+}
+
+
+float Adafruit_BME280::readPressure() {
+    readTemperature(); // required for compensation
+    wire->requestFrom(addr, 3);
+    return bmePres;
+}
+
+
+float Adafruit_BME280::readHumidity() {
+    readTemperature();
+    wire->requestFrom(addr, 2);
+    return bmeHum;
+}
+
+
+bool Adafruit_SHT31::command(uint16_t cmd) {
+    wire->beginTransmission(addr);
+    wire->write((uint8_t)(cmd >> 8));
+    wire->write((uint8_t)(cmd & 0xFF));
+    return wire->endTransmission() == 0;
+}
+
+
+bool Adafruit_SHT31::begin(uint8_t addr) {
+    this->addr = addr;
+    wire->begin();
+    if (!sim_i2c_present(addr) || simOptions.sensor != SIM_SENSOR_SHT31)
+        return false;
+    reset();
+    return true;
+}
+
+
+void Adafruit_SHT31::reset() {
+    command(0x30A2);
+    delay(10);
+}
+
+
+void Adafruit_SHT31::heater(bool enable) {
+    command(enable ? 0x306D : 0x3066);
+}
+
+
+bool Adafruit_SHT31::readBoth(float *temperature, float *humidity) {
+    uint8_t buf[6];
+
+    *temperature = *humidity = NAN;
+    if (!command(0x2400))
+        return false;
+    delay(20);
+    if (wire->requestFrom(addr, 6) != 6)
+        return false;
+    for (uint8_t i = 0; i < 6; i++)
+        buf[i] = wire->read();
+    *temperature = (buf[0] << 8 | buf[1]) * 175.0 / 65535 - 45;
+    *humidity = (buf[3] << 8 | buf[4]) * 100.0 / 65535;
+    return true;
+}
+
+
+float Adafruit_SHT31::readTemperature() {
+    float temperature, humidity;
+
+    readBoth(&temperature, &humidity);
+    return temperature;
+}
+
+
+float Adafruit_SHT31::readHumidity() {
+    float temperature, humidity;
+
+    readBoth(&temperature, &humidity);
+    return humidity;
+}
+
+
+bool Adafruit_Si7021::command(uint8_t cmd) {
+    wire->beginTransmission(SI7021_DEFAULT_ADDRESS);
+    wire->write(cmd);
+    return wire->endTransmission() == 0;
+}
+
+
+bool Adafruit_Si7021::begin() {
+    wire->begin();
+    if (!sim_i2c_present(SI7021_DEFAULT_ADDRESS) || simOptions.sensor != SIM_SENSOR_SI7021)
+        return false;
+    reset();
+    return true;
+}
+
+
+void Adafruit_Si7021::reset() {
+    command(0xFE);
+    delay(50);
+}
+
+
+void Adafruit_Si7021::heater(bool enable) {
+    wire->beginTransmission(SI7021_DEFAULT_ADDRESS);
+    wire->write((uint8_t)0xE6); // user register 1, HTRE bit
+    wire->write((uint8_t)(enable ? 0x3E : 0x3A));
+    wire->endTransmission();
+}
+
+
+// start measurement and read raw result after given time
+int32_t Adafruit_Si7021::measure(uint8_t cmd, uint16_t ms) {
+    if (!command(cmd))
+        return -1;
+    delay(ms);
+    if (wire->requestFrom(SI7021_DEFAULT_ADDRESS, 3) != 3)
+        return -1;
+    int32_t raw = wire->read() << 8;
+    raw |= wire->read();
+    wire->read(); // CRC
+    return raw;
+}
+
+
+float Adafruit_Si7021::readHumidity() {
+    int32_t raw = measure(0xF5, 25);
+
+    return raw < 0 ? NAN : raw * 125.0 / 65536 - 6;
+}
+
+
+float Adafruit_Si7021::readTemperature() {
+    int32_t raw = measure(0xF3, 11);
+
+    return raw < 0 ? NAN : raw * 175.72 / 65536 - 46.85;
+}
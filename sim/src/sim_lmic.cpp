@@ -0,0 +1,454 @@
+/***************************************************************************
+  Copyright (c) 2024 Lars Wessels
+
+  This file is part of the "Feather-M0-LoRaWAN-PM-Sensor" source code.
+  https://github.com/lrswss/feather-m0-lorawan-pm-sensor
+
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+   
+  http://www.apache.org/licenses/LICENSE-2.0
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+***************************************************************************/
+
+#include "Arduino.h"
+#include "lmic.h"
+#include "sim.h"
+
+// emulated LoRaWAN network (EU868, TTN like settings): join accept,
+// DeviceTimeAns, ACK and application downlink (--downlink) in RX1, confirmed
+// uplinks are not repeated if no ACK has been received (--dl-loss), 1% duty
+// cycle; radio windows are registered with the energy model
+#define LMIC_JOIN_RX1_SECS 5
+#define LMIC_RX_SYMBOLS 8
+#define LMIC_DUTY_CYCLE 100     // 1% in sub-band g1 (868.0-868.6 MHz)
+#define LMIC_JOIN_ACCEPT_LEN 17
+#define LMIC_TIME_ANS_LEN 18    // MHDR, FHDR with DeviceTimeAns, MIC
+#define LMIC_FHDR_LEN 8         // MHDR, FHDR without FOpts
+#define LMIC_TTN_RX1_SECS 5     // RX1 delay set in join accept
+#define LMIC_RSSI -95
+#define LMIC_SNR 7
+
+lmic_t LMIC;
+
+static osjob_t *scheduledJobs = NULL;
+static osjob_t *runnableJobs = NULL;
+static osjob_t macJob;
+
+static bool txJoin = false;
+static bool txDownlink = false;
+static bool txAppDownlink = false;
+static bool txConfirmed = false;
+static uint32_t joinAttempts = 0;
+
+static lmic_request_network_time_cb_t *timeCallback = NULL;
+static void *timeUserData = NULL;
+static bool timeRequested = false, timeInFlight = false;
+static lmic_time_reference_t timeReference;
+static bool timeReferenceValid = false;
+
+static void mac_tx(osjob_t *job);
+
+
+// difference of two LMIC times, wraps around like LMIC's clock (after
+// 2^31 ticks, about 9.5 hours awake); computed unsigned since a signed
+// overflow is undefined and the compiler may drop the wrap around
+static ostime_t os_diff(ostime_t a, ostime_t b) {
+    return (ostime_t)((uint32_t)a - (uint32_t)b);
+}
+
+
+// remove job from given list, returns true if found
+static bool os_unlink(osjob_t **list, osjob_t *job) {
+    for (; *list != NULL; list = &(*list)->next) {
+        if (*list == job) {
+            *list = job->next;
+            return true;
+        }
+    }
+    return false;
+}
+
+
+void os_init() {
+    scheduledJobs = runnableJobs = NULL;
+}
+
+
+// 16 μs ticks since startup, LMIC's clock is stopped in standby
+ostime_t os_getTime() {
+    return (ostime_t)(sim_clock_read() / US_PER_OSTICK);
+}
+
+
+void os_clearCallback(osjob_t *job) {
+    os_unlink(&scheduledJobs, job);
+    os_unlink(&runnableJobs, job);
+}
+
+
+void os_setCallback(osjob_t *job, osjobcb_t cb) {
+    osjob_t **list;
+
+    os_clearCallback(job);
+    job->func = cb;
+    job->next = NULL;
+    for (list = &runnableJobs; *list != NULL; list = &(*list)->next);
+    *list = job;
+}
+
+
+// insert job into list of timed jobs (sorted by deadline)
+void os_setTimedCallback(osjob_t *job, ostime_t time, osjobcb_t cb) {
+    osjob_t **list;
+
+    os_clearCallback(job);
+    job->deadline = time;
+    job->func = cb;
+    for (list = &scheduledJobs; *list != NULL && os_diff((*list)->deadline, time) <= 0; list = &(*list)->next);
+    job->next = *list;
+    *list = job;
+}
+
+
+bit_t os_jobIsTimed(osjob_t *job) {
+    for (osjob_t *j = scheduledJobs; j != NULL; j = j->next) {
+        if (j == job)
+            return 1;
+    }
+    return 0;
+}
+
+
+bit_t os_queryTimeCriticalJobs(ostime_t time) {
+    return scheduledJobs != NULL && os_diff(scheduledJobs->deadline, os_getTime()) < time;
+}
+
+
+// run next runnable job or timed job which is due
+void os_runloop_once() {
+    osjob_t *job = NULL;
+
+    if (runnableJobs != NULL) {
+        job = runnableJobs;
+        runnableJobs = job->next;
+    } else if (scheduledJobs != NULL && os_diff(scheduledJobs->deadline, os_getTime()) <= 0) {
+        job = scheduledJobs;
+        scheduledJobs = job->next;
+    }
+    if (job != NULL)
+        job->func(job);
+}
+
+
+// LoRa time on air (125 kHz, CR 4/5, explicit header, CRC)
+static uint64_t mac_airtime(dr_t dr, uint8_t len) {
+    uint8_t sf = 12 - min(dr, DR_SF7), de = sf >= 11 ? 1 : 0;
+    double tsym = (double)(1 << sf) / 125000;
+    double n = ceil((8.0 * len - 4 * sf + 28 + 16) / (4.0 * (sf - 2 * de))) * 5;
+
+    return (12.25 + 8 + max(n, 0.0)) * tsym * 1e6;
+}
+
+
+// symbol time (μs) at 125 kHz
+static uint32_t mac_symbol(dr_t dr) {
+    return (1UL << (12 - min(dr, DR_SF7))) * 8;
+}
+
+
+// receive window opened early and extended by the clock error set
+// with LMIC_setClockError(), received frame (if any) ends the window
+static uint64_t mac_window(dr_t dr, uint32_t delayUs, uint8_t downlink) {
+    uint64_t margin = (uint64_t)delayUs * LMIC.clockError / MAX_CLOCK_ERROR;
+
+    if (downlink > 0)
+        return margin + mac_airtime(dr, downlink);
+    return 2 * margin + LMIC_RX_SYMBOLS * mac_symbol(dr);
+}
+
+
+// schedule transmission of join request or pending data (as
+// soon as duty cycle allows it), not earlier than given ms from now
+static void mac_schedule(uint32_t ms) {
+    ostime_t at = os_getTime() + ms2osticks(ms);
+
+    os_setTimedCallback(&macJob, os_diff(LMIC.bands[0].avail, at) > 0 ? LMIC.bands[0].avail : at, mac_tx);
+}
+
+
+static void mac_random(u1_t *buf, uint8_t len) {
+    for (uint8_t i = 0; i < len; i++)
+        buf[i] = sim_random() * 256;
+}
+
+
+// count uplinks without downlink like LMIC's buildDataFrame(): link is
+// assumed dead after LINK_CHECK_DEAD of them (data rate is lowered, repeated
+// every LINK_CHECK_DEAD uplinks), reported alive again with next downlink
+static void mac_linkcheck() {
+    if (LMIC.adrAckReq == LINK_CHECK_OFF || ++LMIC.adrAckReq != LINK_CHECK_DEAD)
+        return;
+    if (LMIC.datarate > DR_SF12)
+        LMIC.datarate--;
+    LMIC.adrAckReq = LINK_CHECK_CONT;
+    LMIC.opmode |= OP_LINKDEAD;
+    onEvent(EV_LINK_DEAD);
+}
+
+
+// transmission and receive windows completed
+static void mac_txdone(osjob_t *job) {
+    LMIC.opmode &= ~OP_TXRXPEND;
+    LMIC.txrxFlags = 0;
+    LMIC.dataLen = 0;
+    LMIC.dataBeg = 0;
+    if (txDownlink) {
+        LMIC.rssi = LMIC_RSSI + RSSI_OFF;
+        LMIC.snr = LMIC_SNR * 4;
+    }
+
+    if (txJoin) {
+        if (!txDownlink) {
+            onEvent(EV_JOIN_TXCOMPLETE);
+            if (LMIC.datarate > DR_SF12) {
+                LMIC.datarate--;
+            } else {
+                LMIC.datarate = DR_SF7;
+                onEvent(EV_JOIN_FAILED);
+            }
+            mac_schedule(1000 + sim_random() * 2000); // backoff
+            return;
+        }
+        LMIC.netid = 0x13;
+        LMIC.devaddr = 0x260B0000 | (uint32_t)(sim_random() * 0x10000);
+        mac_random(LMIC.nwkKey, sizeof(LMIC.nwkKey));
+        mac_random(LMIC.artKey, sizeof(LMIC.artKey));
+        LMIC.seqnoUp = LMIC.seqnoDn = 0;
+        LMIC.datarate = 12 - constrain(simOptions.sf, 7, 12);
+        LMIC.rxDelay = LMIC_TTN_RX1_SECS;
+        LMIC.dn2Dr = DR_SF9;
+        LMIC.opmode &= ~OP_JOINING;
+        onEvent(EV_JOINED);
+        if (LMIC.opmode & OP_TXDATA)
+            mac_schedule(0);
+        return;
+    }
+
+    if (txDownlink) {
+        if (LMIC.opmode & OP_LINKDEAD) {
+            LMIC.opmode &= ~OP_LINKDEAD;
+            onEvent(EV_LINK_ALIVE);
+        }
+        if (LMIC.adrAckReq != LINK_CHECK_OFF)
+            LMIC.adrAckReq = LINK_CHECK_INIT;
+        LMIC.txrxFlags = TXRX_DNW1 | TXRX_NOPORT;
+        LMIC.dataBeg = timeInFlight ? LMIC_TIME_ANS_LEN - 4 : LMIC_FHDR_LEN;
+        LMIC.seqnoDn++;
+    }
+    if (txAppDownlink) {
+        LMIC.txrxFlags = TXRX_DNW1 | TXRX_PORT;
+        LMIC.frame[LMIC.dataBeg++] = simOptions.downlinkPort;
+        memcpy(LMIC.frame + LMIC.dataBeg, simOptions.downlink, simOptions.downlinkLen);
+        LMIC.dataLen = simOptions.downlinkLen;
+        simOptions.downlinkAt = -1;
+    }
+    if (txConfirmed)
+        LMIC.txrxFlags |= txDownlink ? TXRX_ACK : TXRX_NACK;
+    if (timeInFlight) {
+        timeInFlight = false;
+        timeReferenceValid = txDownlink;
+        if (timeCallback != NULL)
+            timeCallback(timeUserData, txDownlink ? 1 : 0);
+    }
+    LMIC.opmode &= ~(OP_TXDATA | OP_POLL);
+    onEvent(EV_TXCOMPLETE);
+}
+
+
+// transmit join request or pending data, result is
+// reported after the last receive window has been closed
+static void mac_tx(osjob_t *job) {
+    uint64_t now = sim_now(), airtime, rx1, rx2;
+    uint32_t delayUs;
+    uint8_t downlink;
+    bool reachable;
+
+    txJoin = (LMIC.opmode & OP_JOINING) != 0;
+    if (!txJoin && !(LMIC.opmode & OP_TXDATA))
+        return;
+    if (txJoin) {
+        joinAttempts++;
+        reachable = simOptions.joinFail >= 0 && joinAttempts > (uint32_t)simOptions.joinFail;
+        txDownlink = reachable;
+        txAppDownlink = false;
+        txConfirmed = false;
+        LMIC.dataLen = 23;
+        LMIC.devNonce++;
+        delayUs = LMIC_JOIN_RX1_SECS * 1000000UL;
+        downlink = LMIC_JOIN_ACCEPT_LEN;
+    } else {
+        reachable = simOptions.joinFail >= 0 &&
+            !(simOptions.dlLoss > 0 && sim_random() * 100 < simOptions.dlLoss);
+        txConfirmed = LMIC.pendTxConf;
+        txAppDownlink = reachable && simOptions.downlinkAt >= 0 && now >= simOptions.downlinkAt * 3600e6;
+        txDownlink = reachable && (timeRequested || txAppDownlink || txConfirmed);
+        timeInFlight = timeRequested;
+        timeRequested = false;
+        LMIC.dataLen = 13 + LMIC.pendMacLen + LMIC.pendTxLen;
+        LMIC.seqnoUp++;
+        mac_linkcheck();
+        delayUs = max(LMIC.rxDelay, 1) * 1000000UL;
+        downlink = timeInFlight ? LMIC_TIME_ANS_LEN : LMIC_FHDR_LEN + 4;
+        if (txAppDownlink)
+            downlink += 1 + simOptions.downlinkLen;
+    }
+    LMIC.freq = LMIC.channelFreq[(uint8_t)(sim_random() * 3)];
+    LMIC.txCnt = 0;
+    LMIC.opmode |= OP_TXRXPEND;
+    onEvent(EV_TXSTART);
+    sim_energy_uplink(txJoin);
+
+    airtime = mac_airtime(LMIC.datarate, LMIC.dataLen);
+    sim_radio(SIM_RADIO_TX, now, airtime);
+    LMIC.bands[0].avail = os_getTime() + us2osticks(airtime * LMIC.bands[0].txcap);
+    if (timeInFlight && txDownlink) {
+        timeReference.tLocal = os_getTime() + us2osticks(airtime);
+        timeReference.tNetwork = SIM_UTC_START + (now + airtime) / 1000000 - 315964800 + 18;
+        LMIC.netDeviceTimeFrac = (now + airtime) % 1000000 * 256 / 1000000;
+    }
+
+    rx1 = now + airtime + delayUs - mac_window(LMIC.datarate, delayUs, 0) / 2;
+    if (txDownlink) {
+        sim_radio(SIM_RADIO_RX, rx1, mac_window(LMIC.datarate, delayUs, downlink));
+        rx2 = rx1 + mac_window(LMIC.datarate, delayUs, downlink);
+    } else {
+        sim_radio(SIM_RADIO_RX, rx1, mac_window(LMIC.datarate, delayUs, 0));
+        delayUs += 1000000;
+        rx2 = now + airtime + delayUs - mac_window(LMIC.dn2Dr, delayUs, 0) / 2;
+        sim_radio(SIM_RADIO_RX, rx2, mac_window(LMIC.dn2Dr, delayUs, 0));
+        rx2 += mac_window(LMIC.dn2Dr, delayUs, 0);
+    }
+    LMIC.pendMacLen = 0;
+    os_setTimedCallback(&macJob, os_getTime() + us2osticks(rx2 - sim_now()), mac_txdone);
+}
+
+
+void LMIC_reset() {
+    os_clearCallback(&macJob);
+    memset(&LMIC, 0, sizeof(LMIC));
+    LMIC.channelFreq[0] = 868100000;
+    LMIC.channelFreq[1] = 868300000;
+    LMIC.channelFreq[2] = 868500000;
+    for (uint8_t i = 0; i < 3; i++)
+        LMIC.channelDrMap[i] = 0x3F; // DR0 to DR5
+    LMIC.channelMap = 0x07;
+    LMIC.bands[0].txcap = LMIC_DUTY_CYCLE;
+    LMIC.bands[0].avail = os_getTime();
+    LMIC.datarate = DR_SF7;
+    LMIC.adrTxPow = 14;
+    LMIC.txpow = 16;
+    LMIC.rxDelay = 1;
+    LMIC.dn2Dr = DR_SF12;
+    LMIC.dn2Freq = 869525000;
+    LMIC.adrEnabled = 1;
+    LMIC.adrAckReq = LINK_CHECK_INIT;
+    timeRequested = timeInFlight = false;
+}
+
+
+void LMIC_setClockError(u2_t error) {
+    LMIC.clockError = error;
+}
+
+
+bit_t LMIC_startJoining() {
+    if (LMIC.devaddr != 0 || (LMIC.opmode & OP_JOINING))
+        return 0;
+    LMIC.opmode |= OP_JOINING;
+    LMIC.datarate = DR_SF7; // join procedure starts at SF7 again
+    onEvent(EV_JOINING);
+    mac_schedule(0);
+    return 1;
+}
+
+
+int LMIC_setTxData2(u1_t port, u1_t *data, u1_t dlen, u1_t confirmed) {
+    static const uint8_t maxPayload[] = { 51, 51, 51, 115, 222, 222 };
+
+    if (LMIC.opmode & OP_TXRXPEND)
+        return LMIC_ERROR_TX_BUSY;
+    if (dlen > sizeof(LMIC.pendTxData) || dlen + LMIC.pendMacLen > maxPayload[min(LMIC.datarate, DR_SF7)])
+        return LMIC_ERROR_TX_TOO_LARGE;
+    LMIC.pendTxPort = port;
+    LMIC.pendTxConf = confirmed;
+    LMIC.pendTxLen = dlen;
+    memcpy(LMIC.pendTxData, data, dlen);
+    LMIC.opmode |= OP_TXDATA;
+    if (!(LMIC.opmode & OP_JOINING))
+        mac_schedule(0);
+    return LMIC_ERROR_SUCCESS;
+}
+
+
+void LMIC_clrTxData() {
+    if (LMIC.opmode & OP_JOINING)
+        return;
+    LMIC.opmode &= ~(OP_TXDATA | OP_POLL);
+    LMIC.pendTxLen = 0;
+    if (!(LMIC.opmode & OP_TXRXPEND))
+        os_clearCallback(&macJob);
+}
+
+
+void LMIC_setAdrMode(bit_t enabled) {
+    LMIC.adrEnabled = enabled;
+}
+
+
+void LMIC_setLinkCheckMode(bit_t enabled) {
+    LMIC.adrAckReq = enabled ? LINK_CHECK_INIT : LINK_CHECK_OFF;
+}
+
+
+void LMIC_setSession(u4_t netid, devaddr_t devaddr, const u1_t *nwkKey, const u1_t *artKey) {
+    LMIC.netid = netid;
+    LMIC.devaddr = devaddr;
+    memcpy(LMIC.nwkKey, nwkKey, sizeof(LMIC.nwkKey));
+    memcpy(LMIC.artKey, artKey, sizeof(LMIC.artKey));
+    LMIC.seqnoUp = LMIC.seqnoDn = 0;
+    LMIC.opmode &= ~(OP_JOINING | OP_REJOIN | OP_TXRXPEND);
+}
+
+
+void LMIC_setDrTxpow(dr_t dr, s1_t txpow) {
+    LMIC.datarate = dr;
+    if (txpow != KEEP_TXPOW)
+        LMIC.adrTxPow = txpow;
+}
+
+
+// DeviceTimeReq is sent with next uplink
+void LMIC_requestNetworkTime(lmic_request_network_time_cb_t *callback, void *pUserData) {
+    timeCallback = callback;
+    timeUserData = pUserData;
+    if (!timeRequested) {
+        timeRequested = true;
+        LMIC.pendMacLen += 1;
+    }
+}
+
+
+int LMIC_getNetworkTimeReference(lmic_time_reference_t *ref) {
+    if (!timeReferenceValid)
+        return 0;
+    *ref = timeReference;
+    return 1;
+}
@@ -0,0 +1,184 @@
+/***************************************************************************
+  Copyright (c) 2024 Lars Wessels
+
+  This file is part of the "Feather-M0-LoRaWAN-PM-Sensor" source code.
+  https://github.com/lrswss/feather-m0-lorawan-pm-sensor
+
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+   
+  http://www.apache.org/licenses/LICENSE-2.0
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+***************************************************************************/
+
+#include <getopt.h>
+#include "Arduino.h"
+#include "sim.h"
+
+simOptions_t simOptions = {
+    .hours = 24,
+    .seed = 1,
+    .capacity = 2000,
+    .soc = 100,
+    .pm25 = 10,
+    .eventStart = 0,
+    .eventHours = 0,
+    .eventPm25 = 0,
+    .sensor = SIM_SENSOR_BME280,
+    .sf = 7,
+    .rtcPpm = 0,
+    .sdsLoss = 0,
+    .joinFail = 0,
+    .dlLoss = 0,
+    .downlinkAt = -1,
+    .downlinkPort = 0,
+    .downlinkLen = 0,
+    .downlink = { },
+    .log = false,
+    .quiet = false
+};
+
+
+static void usage(const char *name, int status) {
+    fprintf(status ? stderr : stdout,
+        "Usage: %s [options]\n"
+        "  --hours H           simulated time (default 24)\n"
+        "  --seed N            seed for random numbers (default 1)\n"
+        "  --capacity MAH      battery capacity (default 2000)\n"
+        "  --soc PCT           battery charge at start (default 100)\n"
+        "  --pm25 UG           mean PM2.5 in μg/m3 (default 10)\n"
+        "  --event H,D,UG      PM2.5 of UG μg/m3 from hour H for D hours\n"
+        "  --sensor NAME       bme280, sht31, si7021 or none (default bme280)\n"
+        "  --sf SF             spreading factor after join (default 7)\n"
+        "  --rtc-ppm PPM       RTC crystal error, positive if fast (default 0)\n"
+        "  --sds-loss PCT      SDS011 data frames lost (default 0)\n"
+        "  --join-fail N       number of failing join requests, -1 for no network\n"
+        "  --dl-loss PCT       downlinks (e.g. ACKs) lost after join (default 0)\n"
+        "  --downlink H,P,HEX  downlink on port P with first uplink after hour H\n"
+        "  --log               print serial output of firmware to stderr\n"
+        "  --quiet             print summary only\n"
+        "  --help              print this help\n", name);
+    exit(status);
+}
+
+
+static void options(int argc, char **argv) {
+    static const struct option longopts[] = {
+        { "hours", required_argument, NULL, 'h' },
+        { "seed", required_argument, NULL, 'r' },
+        { "capacity", required_argument, NULL, 'c' },
+        { "soc", required_argument, NULL, 'b' },
+        { "pm25", required_argument, NULL, 'p' },
+        { "event", required_argument, NULL, 'e' },
+        { "sensor", required_argument, NULL, 's' },
+        { "sf", required_argument, NULL, 'f' },
+        { "rtc-ppm", required_argument, NULL, 't' },
+        { "sds-loss", required_argument, NULL, 'x' },
+        { "join-fail", required_argument, NULL, 'j' },
+        { "dl-loss", required_argument, NULL, 'k' },
+        { "downlink", required_argument, NULL, 'd' },
+        { "log", no_argument, NULL, 'l' },
+        { "quiet", no_argument, NULL, 'q' },
+        { "help", no_argument, NULL, 'u' },
+        { NULL, 0, NULL, 0 }
+    };
+    const char *sensors[] = { "none", "bme280", "sht31", "si7021" };
+    int opt, i, n, port;
+    unsigned int byte;
+
+    while ((opt = getopt_long(argc, argv, "", longopts, NULL)) != -1) {
+        switch (opt) {
+            case 'h': simOptions.hours = atof(optarg); break;
+            case 'r': simOptions.seed = atol(optarg); break;
+            case 'c': simOptions.capacity = atof(optarg); break;
+            case 'b': simOptions.soc = atof(optarg); break;
+            case 'p': simOptions.pm25 = atof(optarg); break;
+            case 'e':
+                if (sscanf(optarg, "%lf,%lf,%lf", &simOptions.eventStart,
+                        &simOptions.eventHours, &simOptions.eventPm25) != 3)
+                    usage(argv[0], 2);
+                break;
+            case 's':
+                for (i = 0; i < 4 && strcmp(optarg, sensors[i]) != 0; i++);
+                if (i == 4)
+                    usage(argv[0], 2);
+                simOptions.sensor = (simSensor_t)i;
+                break;
+            case 'f': simOptions.sf = atoi(optarg); break;
+            case 't': simOptions.rtcPpm = atof(optarg); break;
+            case 'x': simOptions.sdsLoss = atof(optarg); break;
+            case 'j': simOptions.joinFail = atol(optarg); break;
+            case 'k': simOptions.dlLoss = atof(optarg); break;
+            case 'd':
+                if (sscanf(optarg, "%lf,%d,%n", &simOptions.downlinkAt, &port, &n) != 2 ||
+                        port < 1 || port > 223 || strlen(optarg + n) % 2 != 0)
+                    usage(argv[0], 2);
+                simOptions.downlinkPort = port;
+                for (optarg += n; *optarg != '\0'; optarg += 2) {
+                    if (simOptions.downlinkLen == sizeof(simOptions.downlink) ||
+                            sscanf(optarg, "%2x", &byte) != 1)
+                        usage(argv[0], 2);
+                    simOptions.downlink[simOptions.downlinkLen++] = byte;
+                }
+                break;
+            case 'l': simOptions.log = true; break;
+            case 'q': simOptions.quiet = true; break;
+            case 'u': usage(argv[0], 0);
+            default: usage(argv[0], 2);
+        }
+    }
+    if (optind < argc || simOptions.hours <= 0 || simOptions.capacity <= 0 ||
+            simOptions.sf < 7 || simOptions.sf > 12)
+        usage(argv[0], 2);
+}
+
+
+// hour of day (UTC) at given time
+static double env_hour(uint64_t us) {
+    return fmod((SIM_UTC_START % 86400) / 3600.0 + us / 3600e6, 24);
+}
+
+
+// PM2.5 with daily variation (low at night, high in the evening),
+// replaced by given value during PM event
+double sim_env_pm25(uint64_t us) {
+    double hours = us / 3600e6;
+
+    if (simOptions.eventHours > 0 && hours >= simOptions.eventStart &&
+            hours < simOptions.eventStart + simOptions.eventHours)
+        return simOptions.eventPm25;
+    return simOptions.pm25 * (1 + 0.4 * sin(2 * M_PI * (env_hour(us) - 12) / 24));
+}
+
+
+double sim_env_temperature(uint64_t us) {
+    return 15 + 6 * sin(2 * M_PI * (env_hour(us) - 9) / 24);
+}
+
+
+double sim_env_humidity(uint64_t us) {
+    return 65 - 20 * sin(2 * M_PI * (env_hour(us) - 9) / 24);
+}
+
+
+// Pa, slowly changing weather
+double sim_env_pressure(uint64_t us) {
+    return 101325 + 800 * sin(2 * M_PI * us / (72 * 3600e6));
+}
+
+
+int main(int argc, char **argv) {
+    options(argc, argv);
+    setvbuf(stdout, NULL, _IOLBF, 0);
+    sim_report_header();
+    setup();
+    for (;;)
+        loop();
+}
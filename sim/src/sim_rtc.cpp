@@ -0,0 +1,152 @@
+/***************************************************************************
+  Copyright (c) 2024 Lars Wessels
+
+  This file is part of the "Feather-M0-LoRaWAN-PM-Sensor" source code.
+  https://github.com/lrswss/feather-m0-lorawan-pm-sensor
+
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+   
+  http://www.apache.org/licenses/LICENSE-2.0
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+***************************************************************************/
+
+#include "Arduino.h"
+#include "RTCZero.h"
+#include "sim.h"
+
+// RTC counts seconds of the virtual wall clock, its crystal is off by
+// --rtc-ppm and corrected by the frequency correction register (steps of
+// 1/976562); rtcSecs is the RTC (with fraction) at virtual time rtcUs
+static double rtcSecs = SIM_RTC_START;
+static uint64_t rtcUs = 0;
+static Rtc rtcRegs;
+Rtc *RTC = &rtcRegs;
+
+
+// RTC seconds per second of virtual wall clock
+static double rtc_rate() {
+    uint8_t freqCorr = RTC->MODE2.FREQCORR.reg;
+    double corr = RTC_FREQCORR_VALUE(freqCorr) / 0.976562;
+
+    return 1 + (simOptions.rtcPpm + ((freqCorr & RTC_FREQCORR_SIGN) ? corr : -corr)) / 1e6;
+}
+
+
+static double rtc_secs() {
+    return rtcSecs + (sim_now() - rtcUs) / 1e6 * rtc_rate();
+}
+
+
+RtcFreqCorr& RtcFreqCorr::operator=(uint8_t value) {
+    rtcSecs = rtc_secs();
+    rtcUs = sim_now();
+    this->value = value;
+    return *this;
+}
+
+
+void RTCZero::begin(bool resetTime) {
+    if (resetTime) {
+        rtcSecs = SIM_RTC_START;
+        rtcUs = sim_now();
+    }
+}
+
+
+uint32_t RTCZero::getEpoch() {
+    return rtc_secs();
+}
+
+
+// like the real RTC the prescaler is not reset, fraction of second is kept
+void RTCZero::setEpoch(uint32_t ts) {
+    double secs = rtc_secs();
+
+    rtcSecs = ts + (secs - floor(secs));
+    rtcUs = sim_now();
+}
+
+
+uint8_t RTCZero::getHours() {
+    return (getEpoch() / 3600) % 24;
+}
+
+
+uint8_t RTCZero::getMinutes() {
+    return (getEpoch() / 60) % 60;
+}
+
+
+uint8_t RTCZero::getSeconds() {
+    return getEpoch() % 60;
+}
+
+
+void RTCZero::setAlarmEpoch(uint32_t ts) {
+    alarm = ts;
+}
+
+
+uint8_t RTCZero::getAlarmHours() {
+    return (alarm / 3600) % 24;
+}
+
+
+uint8_t RTCZero::getAlarmMinutes() {
+    return (alarm / 60) % 60;
+}
+
+
+uint8_t RTCZero::getAlarmSeconds() {
+    return alarm % 60;
+}
+
+
+void RTCZero::enableAlarm(Alarm_Match match) {
+    this->match = match;
+}
+
+
+void RTCZero::disableAlarm() {
+    match = MATCH_OFF;
+}
+
+
+void RTCZero::attachInterrupt(voidFuncPtr callback) {
+    this->callback = callback;
+}
+
+
+// standby until RTC matches alarm, like the real RTC an alarm which has
+// just passed only matches again after a full period (e.g. a day)
+void RTCZero::standbyMode() {
+    uint32_t now = getEpoch();
+    uint64_t period, secs, us;
+
+    switch (match) {
+        case MATCH_SS: period = 60; break;
+        case MATCH_MMSS: period = 3600; break;
+        case MATCH_HHMMSS: period = 86400; break;
+        case MATCH_OFF:
+            sim_warn("Standby without RTC alarm, node would never wake up!");
+            sim_report_finish();
+            exit(1);
+        default: period = 1ULL << 32; break;
+    }
+    secs = (alarm % period + period - now % period) % period;
+    if (secs == 0)
+        secs = period;
+    us = ceil((now + secs - rtc_secs()) / rtc_rate() * 1e6);
+    sim_advance(us, SIM_STANDBY);
+    sim_energy_standby(us);
+    if (callback != 0)
+        callback();
+}
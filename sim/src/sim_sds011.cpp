@@ -0,0 +1,191 @@
+/***************************************************************************
+  Copyright (c) 2024 Lars Wessels
+
+  This file is part of the "Feather-M0-LoRaWAN-PM-Sensor" source code.
+  https://github.com/lrswss/feather-m0-lorawan-pm-sensor
+
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+   
+  http://www.apache.org/licenses/LICENSE-2.0
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+***************************************************************************/
+
+#include "Arduino.h"
+#include "sim.h"
+
+// emulated Nova Fitness SDS011 (laser dust sensor control protocol V1.3),
+// powers up in working mode with active reporting (one frame per second)
+#define SDS011_BYTE_US 1042     // 9600 baud
+#define SDS011_REPLY_US 5000    // until reply to command is sent
+#define SDS011_REPORT_US 1000000
+#define SDS011_SETTLE_SECS 6.0  // time constant of warmup error
+#define SDS011_ID 0xA1B2
+#define SDS011_QUEUE 64
+
+static bool working = true;
+static bool queryMode = false;
+static uint64_t workingSince = 0;
+static uint64_t nextReport = SDS011_REPORT_US;
+static double warmupError = 0.5; // relative error of reading at fan start
+
+static uint8_t cmd[19];
+static uint8_t cmdLen = 0;
+
+// bytes sent to MCU with time they are received
+static struct {
+    uint8_t c;
+    uint64_t due;
+} queue[SDS011_QUEUE];
+static uint8_t queueHead = 0;
+static uint8_t queueCount = 0;
+
+
+// queue reply frame (head, command, 6 data bytes, checksum, tail)
+static void sds011_send(uint64_t at, uint8_t type, const uint8_t *data) {
+    uint8_t frame[10] = { 0xAA, type }, crc = 0;
+
+    for (uint8_t i = 0; i < 6; i++) {
+        frame[2 + i] = data[i];
+        crc += data[i];
+    }
+    frame[8] = crc;
+    frame[9] = 0xAB;
+    for (uint8_t i = 0; i < sizeof(frame) && queueCount < SDS011_QUEUE; i++) {
+        queue[(queueHead + queueCount) % SDS011_QUEUE].c = frame[i];
+        queue[(queueHead + queueCount) % SDS011_QUEUE].due = at + (i + 1) * SDS011_BYTE_US;
+        queueCount++;
+    }
+}
+
+
+// reading (1/10 μg/m3) for given true value, deviates from it after
+// fan start (decaying error) and has some noise (±3%, ±0.2 μg/m3)
+static uint16_t sds011_value(double pm, uint64_t at) {
+    double secs = (at - workingSince) / 1e6;
+
+    pm *= 1 + warmupError * exp(-secs / SDS011_SETTLE_SECS);
+    pm *= 1 + (sim_random() - 0.5) * 0.06;
+    pm += (sim_random() - 0.5) * 0.4;
+    return constrain(lround(pm * 10), 0L, 9999L);
+}
+
+
+// data frame (active mode or reply to query), might be lost (--sds-loss)
+static void sds011_report(uint64_t at) {
+    uint16_t pm25 = sds011_value(sim_env_pm25(at), at);
+    uint16_t pm10 = sds011_value(sim_env_pm25(at) * 1.5, at);
+    uint8_t data[6] = { (uint8_t)(pm25 & 0xFF), (uint8_t)(pm25 >> 8),
+        (uint8_t)(pm10 & 0xFF), (uint8_t)(pm10 >> 8), SDS011_ID >> 8, SDS011_ID & 0xFF };
+
+    if (simOptions.sdsLoss > 0 && sim_random() * 100 < simOptions.sdsLoss)
+        return;
+    sds011_send(at, 0xC0, data);
+}
+
+
+// execute complete command frame received at given time, a
+// sleeping SDS011 only answers the sleep/work command
+static void sds011_command(uint64_t at) {
+    uint8_t crc = 0, data[6] = { cmd[2], cmd[3], cmd[4], 0, SDS011_ID >> 8, SDS011_ID & 0xFF };
+
+    for (uint8_t i = 2; i < 17; i++)
+        crc += cmd[i];
+    if (cmd[1] != 0xB4 || cmd[17] != crc || cmd[18] != 0xAB) {
+        sim_warn("SDS011: invalid command frame");
+        return;
+    }
+    at += SDS011_REPLY_US;
+
+    if (cmd[2] == 0x06) {
+        if (cmd[3] == 1 && cmd[4] == 1 && !working) {
+            workingSince = at;
+            warmupError = sim_random() * 1.2 - 0.4;
+            nextReport = at + SDS011_REPORT_US;
+        }
+        if (cmd[3] == 1)
+            working = cmd[4];
+        data[2] = working;
+        sds011_send(at, 0xC5, data);
+        return;
+    }
+    if (!working)
+        return;
+
+    switch (cmd[2]) {
+        case 0x02: // reporting mode
+            if (cmd[3] == 1)
+                queryMode = cmd[4];
+            data[2] = queryMode;
+            sds011_send(at, 0xC5, data);
+            break;
+        case 0x04: // query data
+            sds011_report(at);
+            break;
+        case 0x07: // firmware version (yy, mm, dd)
+            data[1] = 18;
+            data[2] = 11;
+            data[3] = 16;
+            sds011_send(at, 0xC5, data);
+            break;
+        default:
+            sim_warn("SDS011: unsupported command 0x%02X", cmd[2]);
+            break;
+    }
+}
+
+
+// byte sent by MCU, received by SDS011 at given time
+void sim_sds011_receive(uint8_t c, uint64_t at) {
+    if (cmdLen == 0 && c != 0xAA)
+        return;
+    cmd[cmdLen++] = c;
+    if (cmdLen == sizeof(cmd)) {
+        sds011_command(at);
+        cmdLen = 0;
+    }
+}
+
+
+// time of next byte sent to MCU
+uint64_t sim_sds011_next() {
+    uint64_t next = UINT64_MAX;
+
+    if (queueCount > 0)
+        next = queue[queueHead].due;
+    if (working && !queryMode)
+        next = min(next, nextReport);
+    return next;
+}
+
+
+// queue reports (active mode) and pass received bytes to
+// SERCOM1 unless they are lost since MCU is in standby
+void sim_sds011_update(uint64_t now, bool deliver) {
+    uint8_t c;
+
+    while (working && !queryMode && nextReport <= now) {
+        sds011_report(nextReport);
+        nextReport += SDS011_REPORT_US;
+    }
+    while (queueCount > 0 && queue[queueHead].due <= now) {
+        c = queue[queueHead].c;
+        queueHead = (queueHead + 1) % SDS011_QUEUE;
+        queueCount--;
+        if (deliver)
+            sim_uart_receive(c);
+    }
+}
+
+
+// fan and laser diode are on
+bool sim_sds011_running() {
+    return working;
+}
@@ -0,0 +1,143 @@
+/***************************************************************************
+  Copyright (c) 2024 Lars Wessels
+
+  This file is part of the "Feather-M0-LoRaWAN-PM-Sensor" source code.
+  https://github.com/lrswss/feather-m0-lorawan-pm-sensor
+
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+   
+  http://www.apache.org/licenses/LICENSE-2.0
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+***************************************************************************/
+
+#include "airtime.h"
+#include "utils.h"
+#include <lmic.h>
+
+#define LOG_MODULE LOG_LEVEL_LORAWAN
+
+static uint32_t hourBuckets[AIRTIME_HOUR_BUCKETS];
+static uint32_t hourStamp = 0; // number of newest 5 minute bucket
+static uint32_t dayBuckets[AIRTIME_DAY_BUCKETS];
+static uint32_t dayStamp = 0; // number of newest hourly bucket
+static uint32_t cycleAirtime = 0; // airtime since last call of airtime_interval()
+static uint32_t avgAirtime = 0; // moving average of airtime per cycle
+
+
+// LoRa time on air in ms for given EU868 data rate and frame length
+// (explicit header, CRC, coding rate 4/5, 8 preamble symbols)
+// see Semtech AN1200.13 "LoRa Modem Designer's Guide"
+uint32_t airtime_ms(uint8_t datarate, uint8_t len) {
+    uint8_t sf, de;
+    uint32_t tsym, nsym;
+    int32_t bits;
+
+    if (datarate == DR_FSK) // 50 kbps, 5 bytes preamble, 3 sync, 1 length, 2 CRC
+        return ((11 + len) * 8 + 49) / 50;
+
+    sf = 12 - min(datarate, DR_SF7);
+    de = (sf >= 11) ? 1 : 0; // low data rate optimization
+    tsym = (1UL << sf) * (datarate == DR_SF7B ? 4 : 8); // symbol time in μs (250 or 125 kHz)
+    bits = 8 * len - 4 * sf + 28 + 16;
+    nsym = 8;
+    if (bits > 0)
+        nsym += ((bits + 4 * (sf - 2 * de) - 1) / (4 * (sf - 2 * de))) * 5;
+    // preamble has 8 + 4.25 symbols
+    return ((49 + 4 * nsym) * tsym / 4 + 999) / 1000;
+}
+
+
+// time in ms the radio listens in a receive window at given data rate, which
+// is opened given margin (ms, clock error) early: until the end of a received
+// frame of given length or AIRTIME_RX_SYMBOLS plus margin if len is 0
+uint32_t airtime_rx_ms(uint8_t datarate, uint32_t margin, uint8_t len) {
+    if (len > 0)
+        return margin + airtime_ms(datarate, len);
+    return 2 * margin + ((1UL << (12 - min(datarate, DR_SF7))) * 8 * AIRTIME_RX_SYMBOLS + 999) / 1000;
+}
+
+
+// move rolling buckets forward to given bucket number, clearing expired buckets
+static void airtime_advance(uint32_t *buckets, uint8_t n, uint32_t *stamp, uint32_t bucket) {
+    if (bucket <= *stamp)
+        return;
+    if (bucket - *stamp >= n) {
+        memset(buckets, 0, n * sizeof(uint32_t));
+    } else {
+        while (*stamp < bucket)
+            buckets[++(*stamp) % n] = 0;
+    }
+    *stamp = bucket;
+}
+
+
+static uint32_t airtime_sum(uint32_t *buckets, uint8_t n) {
+    uint32_t sum = 0;
+
+    for (uint8_t i = 0; i < n; i++)
+        sum += buckets[i];
+    return sum;
+}
+
+
+// account airtime of a transmission at given time (epoch)
+void airtime_add(uint32_t ms, uint32_t now) {
+    airtime_advance(hourBuckets, AIRTIME_HOUR_BUCKETS, &hourStamp, now / 300);
+    airtime_advance(dayBuckets, AIRTIME_DAY_BUCKETS, &dayStamp, now / 3600);
+    hourBuckets[hourStamp % AIRTIME_HOUR_BUCKETS] += ms;
+    dayBuckets[dayStamp % AIRTIME_DAY_BUCKETS] += ms;
+    cycleAirtime += ms;
+}
+
+
+// returns airtime in ms used within last hour
+uint32_t airtime_hour(uint32_t now) {
+    airtime_advance(hourBuckets, AIRTIME_HOUR_BUCKETS, &hourStamp, now / 300);
+    return airtime_sum(hourBuckets, AIRTIME_HOUR_BUCKETS);
+}
+
+
+// returns airtime in ms used within last 24 hours
+uint32_t airtime_day(uint32_t now) {
+    airtime_advance(dayBuckets, AIRTIME_DAY_BUCKETS, &dayStamp, now / 3600);
+    return airtime_sum(dayBuckets, AIRTIME_DAY_BUCKETS);
+}
+
+
+// returns true if transmission with given airtime stays within limits
+bool airtime_available(uint32_t ms, uint32_t now) {
+    return (airtime_hour(now) + ms) <= AIRTIME_HOURLY_MS &&
+        (airtime_day(now) + ms) <= AIRTIME_DAILY_MS;
+}
+
+
+// returns observation interval (at least given secs) which keeps the average
+// airtime per cycle within hourly and daily limits; interval is stretched
+// at higher spreading factors and shrinks back to secs again at lower ones
+uint16_t airtime_interval(uint16_t secs, uint32_t now) {
+    uint32_t interval = secs;
+
+    avgAirtime = (avgAirtime == 0) ? cycleAirtime : (3 * avgAirtime + cycleAirtime) / 4;
+    cycleAirtime = 0;
+
+    interval = max(interval, avgAirtime * 3600 / AIRTIME_HOURLY_MS);
+    interval = max(interval, avgAirtime * 86400 / AIRTIME_DAILY_MS);
+
+    // daily budget already used up, wait for oldest hour to expire
+    if (airtime_day(now) >= AIRTIME_DAILY_MS)
+        interval = max(interval, 3600UL);
+
+    interval = min(interval, 65535UL);
+    if (interval > secs)
+        log_info("Airtime %ld ms/cycle (%ld ms/h, %ld ms/24h), stretching interval to %ld secs",
+            avgAirtime, airtime_hour(now), airtime_day(now), interval);
+    return interval;
+}
@@ -0,0 +1,105 @@
+/***************************************************************************
+  Copyright (c) 2024 Lars Wessels
+
+  This file is part of the "Feather-M0-LoRaWAN-PM-Sensor" source code.
+  https://github.com/lrswss/feather-m0-lorawan-pm-sensor
+
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+   
+  http://www.apache.org/licenses/LICENSE-2.0
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+***************************************************************************/
+
+#include "alert.h"
+#include "utils.h"
+
+#define LOG_MODULE LOG_LEVEL_SENSORS
+
+static uint8_t reasons = ALERT_NONE;
+static bool active = false;
+static int16_t lastPm25 = -1, lastPm10 = -1;
+static uint32_t budgetStart = 0;
+static uint8_t budgetUsed = 0;
+
+
+// returns true if PM value (μg/m3 * 10) is above limit (μg/m3),
+// lowered by hysteresis if alert for this value is already active
+static bool alert_exceeded(int16_t pm, uint16_t limit, bool alerted) {
+    uint32_t threshold = limit * 10;
+
+    if (alerted)
+        threshold = threshold * (100 - ALERT_HYSTERESIS_PCT) / 100;
+    return pm >= (int32_t)threshold;
+}
+
+
+// returns true if PM value rose quickly since previous observation
+static bool alert_rising(int16_t pm, int16_t last) {
+    if (last < 0 || pm <= last)
+        return false;
+    return (pm - last) >= max((int32_t)last * ALERT_RISE_PCT / 100, ALERT_RISE_MIN * 10);
+}
+
+
+// returns true if another observation can be sent in alert state
+static bool alert_budget(uint32_t now) {
+    if (budgetStart == 0 || (now - budgetStart) >= ALERT_BUDGET_SECS) {
+        budgetStart = now;
+        budgetUsed = 0;
+    }
+    if (budgetUsed >= ALERT_BUDGET)
+        return false;
+    budgetUsed++;
+    return true;
+}
+
+
+// check latest PM readings against alert thresholds, alert reasons are
+// reported with observation; alert state (short interval, immediate
+// transmission) is limited by budget of ALERT_BUDGET observations
+uint8_t alert_update(sensorReadings_t *readings, uint32_t now) {
+    uint8_t next = ALERT_NONE;
+
+    if ((readings->status & SENSORS_SDS011_ERROR) == 0 && readings->pm25 >= 0) {
+        if (alert_exceeded(readings->pm25, ALERT_PM25_LIMIT, reasons & ALERT_PM25))
+            next |= ALERT_PM25;
+        if (alert_exceeded(readings->pm10, ALERT_PM10_LIMIT, reasons & ALERT_PM10))
+            next |= ALERT_PM10;
+        if (alert_rising(readings->pm25, lastPm25) || alert_rising(readings->pm10, lastPm10))
+            next |= ALERT_RISE;
+        lastPm25 = readings->pm25;
+        lastPm10 = readings->pm10;
+    }
+
+    if (next != ALERT_NONE && reasons == ALERT_NONE)
+        log_warn("[WARNING] PM alert (reasons 0x%02X)", next);
+    else if (next == ALERT_NONE && reasons != ALERT_NONE)
+        log_info("PM alert cleared");
+    reasons = next;
+
+    active = (reasons != ALERT_NONE) && alert_budget(now);
+    if (reasons != ALERT_NONE && !active)
+        log_warn("[WARNING] PM alert budget exhausted (%d per %ld secs)", ALERT_BUDGET, ALERT_BUDGET_SECS);
+    readings->alert = reasons;
+    return reasons;
+}
+
+
+// returns true if observation should be sent immediately
+bool alert_active() {
+    return active;
+}
+
+
+// returns given interval, shortened to ALERT_INTERVAL_SECS in alert state
+uint16_t alert_interval(uint16_t secs) {
+    return active ? min(secs, ALERT_INTERVAL_SECS) : secs;
+}
@@ -0,0 +1,175 @@
+/***************************************************************************
+  Copyright (c) 2024 Lars Wessels
+
+  This file is part of the "Feather-M0-LoRaWAN-PM-Sensor" source code.
+  https://github.com/lrswss/feather-m0-lorawan-pm-sensor
+
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+   
+  http://www.apache.org/licenses/LICENSE-2.0
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+***************************************************************************/
+
+#include "battery.h"
+#include "utils.h"
+#include "rtc.h"
+
+#define LOG_MODULE LOG_LEVEL_SYSTEM
+
+// open circuit voltage (mV) of a single Li-Ion cell at 0, 10, ..., 100 %
+// state of charge, voltage is almost flat between 20 and 60 %
+static const uint16_t socCurve[] = {
+    3300, 3690, 3730, 3770, 3800, 3840, 3870, 3950, 4020, 4110, 4200
+};
+
+static uint16_t filtered = 0;  // smoothed battery voltage (mV)
+static uint8_t soc = 0;
+static uint8_t tier = BATTERY_NORMAL;
+static uint8_t pmCycle = 0;
+
+
+// oversample battery voltage, ignoring lowest and highest ADC sample
+static uint16_t battery_sample() {
+#ifdef VBAT_PIN
+    uint16_t sample, lo = 0xFFFF, hi = 0;
+    uint32_t sum = 0;
+
+    analogReadResolution(12);
+    for (uint8_t i = 0; i < BATTERY_SAMPLES; i++) {
+        sample = analogRead(VBAT_PIN);
+        lo = min(lo, sample);
+        hi = max(hi, sample);
+        sum += sample;
+    }
+    analogReadResolution(10);
+    sum -= lo + hi;
+    return (sum * VBAT_MULTIPLIER * 3300) / (4096UL * (BATTERY_SAMPLES - 2));
+#else
+    return 0;
+#endif
+}
+
+
+// map battery voltage to state of charge (%) using discharge curve
+static uint8_t battery_curve(uint16_t mv) {
+    const uint8_t steps = sizeof(socCurve) / sizeof(socCurve[0]) - 1;
+
+    if (mv <= socCurve[0])
+        return 0;
+    for (uint8_t i = 1; i <= steps; i++) {
+        if (mv < socCurve[i])
+            return (i - 1) * 10 + (mv - socCurve[i-1]) * 10 / (socCurve[i] - socCurve[i-1]);
+    }
+    return 100;
+}
+
+
+// power tier for current state of charge, returning to a higher
+// tier requires state of charge to rise above threshold plus hysteresis
+static uint8_t battery_policy() {
+    const uint8_t thresholds[] = { 100, BATTERY_LOW_SOC, BATTERY_CRITICAL_SOC, BATTERY_HIBERNATE_SOC };
+    uint8_t next = BATTERY_NORMAL;
+
+    if (filtered == 0) // not connected or charging
+        return BATTERY_NORMAL;
+    while (next < BATTERY_HIBERNATE && soc <= thresholds[next + 1])
+        next++;
+    while (next < tier && soc <= thresholds[next + 1] + BATTERY_HYSTERESIS_SOC)
+        next++;
+    return next;
+}
+
+
+// take new (filtered) battery measurement, update state of charge
+// and power tier, returns 0 if not connected or currently charging
+uint16_t battery_read() {
+    uint16_t mv = battery_sample();
+    uint8_t next;
+
+    if (mv < VBAT_MIN_MV || mv > VBAT_MAX_MV) {
+        filtered = 0;
+        soc = 0;
+    } else {
+        if (filtered == 0 || abs(mv - filtered) > BATTERY_FILTER_RESET_MV)
+            filtered = mv;
+        else
+            filtered = ((BATTERY_FILTER - 1) * (uint32_t)filtered + mv + BATTERY_FILTER / 2) / BATTERY_FILTER;
+        soc = battery_curve(filtered);
+    }
+
+    next = battery_policy();
+    if (next != tier)
+        log_info("Battery at %d%% (%d mV), changing power tier from %d to %d", soc, filtered, tier, next);
+    tier = next;
+    return filtered;
+}
+
+
+// returns last filtered battery voltage (mV)
+uint16_t battery_mv() {
+    return filtered;
+}
+
+
+// returns state of charge (%) for last measurement
+uint8_t battery_soc() {
+    return soc;
+}
+
+
+// battery level as reported in DevStatusAns (LoRaWAN 1.0.3, 5.5)
+// 0 = external power, 1..254 = battery level, 255 = unable to measure
+uint8_t battery_level() {
+#ifdef VBAT_PIN
+    if (filtered == 0)
+        battery_read();
+    if (filtered == 0)
+        return 0;
+    return 1 + (uint16_t)soc * 253 / 100;
+#else
+    return 255;
+#endif
+}
+
+
+// returns current power tier (see battery.h)
+uint8_t battery_tier() {
+    return tier;
+}
+
+
+// returns true if SDS011 should not be used for next observation
+bool battery_skip_pm() {
+    if (tier >= BATTERY_CRITICAL)
+        return true;
+    if (tier == BATTERY_LOW)
+        return (pmCycle++ % BATTERY_LOW_PM_CYCLES) != 0;
+    pmCycle = 0;
+    return false;
+}
+
+
+// stretch observation interval according to power tier
+uint16_t battery_interval(uint16_t secs) {
+    if (tier == BATTERY_NORMAL)
+        return secs;
+    return min((uint32_t)secs << min(tier, BATTERY_CRITICAL), 0xFFFFUL);
+}
+
+
+// stay in standby (no observations, no transmissions) while
+// battery is at hibernate level, recheck every BATTERY_HIBERNATE_SECS
+void battery_hibernate() {
+    while (battery_read() && tier == BATTERY_HIBERNATE) {
+        log_warn("[WARNING] Battery at %d%% (%d mV), hibernating...", soc, filtered);
+        sleep(BATTERY_HIBERNATE_SECS);
+    }
+}
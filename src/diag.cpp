@@ -0,0 +1,135 @@
+/***************************************************************************
+  Copyright (c) 2024 Lars Wessels
+
+  This file is part of the "Feather-M0-LoRaWAN-PM-Sensor" source code.
+  https://github.com/lrswss/feather-m0-lorawan-pm-sensor
+
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+   
+  http://www.apache.org/licenses/LICENSE-2.0
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+***************************************************************************/
+
+#include "diag.h"
+#include "nvm.h"
+#include "rtc.h"
+#include "utils.h"
+
+#define LOG_MODULE LOG_LEVEL_SYSTEM
+
+#ifdef DIAGNOSTICS
+typedef struct {
+    uint32_t magic;
+    uint32_t seqno; // incremented with every save
+    uint32_t counters[DIAG_COUNTERS];
+    uint8_t crc; // covers all bytes before
+} diagRecord_t;
+
+NVM_AREA(diagArea, DIAG_ROWS);
+
+static diagRecord_t diag;
+static uint8_t diagRow = 0;
+static uint32_t lastAwake = 0; // millis() at last update
+static uint32_t lastStandby = 0; // standby ms (uptime_ms() - millis()) at last update
+static uint32_t lastReport = 0;
+static bool requested = false;
+
+
+// add time spent awake and in standby since last call, millis()
+// stops in standby, uptime_ms() includes time spent in standby
+static void diag_update() {
+    uint32_t awake = millis(), standby = uptime_ms() - awake;
+    uint32_t standbyMs = standby - lastStandby;
+
+    diag.counters[DIAG_AWAKE_MS] += awake - lastAwake;
+    diag.counters[DIAG_STANDBY_SECS] += standbyMs / 1000;
+    lastAwake = awake;
+    lastStandby = standby - standbyMs % 1000; // keep remainder
+}
+
+
+// write counters to next flash row
+static void diag_save() {
+    static_assert(sizeof(diagRecord_t) <= NVM_ROW_SIZE, "diagRecord_t must fit into a flash row");
+    diag_update();
+    diagRow = (diagRow + 1) % DIAG_ROWS;
+    diag.magic = DIAG_MAGIC;
+    diag.seqno++;
+    diag.crc = crc8((uint8_t *)&diag, offsetof(diagRecord_t, crc));
+    nvm_erase(diagArea + diagRow * NVM_ROW_SIZE);
+    nvm_write(diagArea + diagRow * NVM_ROW_SIZE, &diag, sizeof(diagRecord_t));
+}
+
+
+// restore latest counters saved in flash and count startup
+void diag_init() {
+    diagRecord_t record;
+
+    memset(&diag, 0, sizeof(diag));
+    for (uint8_t row = 0; row < DIAG_ROWS; row++) {
+        nvm_read(diagArea + row * NVM_ROW_SIZE, &record, sizeof(diagRecord_t));
+        if (record.magic == DIAG_MAGIC && record.seqno >= diag.seqno &&
+                record.crc == crc8((uint8_t *)&record, offsetof(diagRecord_t, crc))) {
+            diag = record;
+            diagRow = row;
+        }
+    }
+    diag.counters[DIAG_RESETS]++;
+    diag_save();
+    lastReport = uptime_ms();
+    log_info("Diagnostics counters restored (startup %ld)", diag.counters[DIAG_RESETS]);
+}
+
+
+void diag_add(diagCounter_t counter, uint32_t value) {
+    diag.counters[counter] += value;
+}
+
+
+// send report with next uplink (downlink on DIAG_PORT)
+void diag_request() {
+    log_info("Diagnostics report requested");
+    requested = true;
+}
+
+
+// returns true if report has been requested or is due
+bool diag_due() {
+    return requested || (uptime_ms() - lastReport) >= DIAG_REPORT_SECS * 1000UL;
+}
+
+
+// encode counters into buf (at least DIAG_MAX_SIZE bytes), returns length
+uint8_t diag_encode(uint8_t *buf) {
+    uint8_t len = 0;
+    uint32_t value;
+
+    diag_update();
+    buf[len++] = DIAG_PAYLOAD_VERSION;
+    for (uint8_t i = 0; i < DIAG_COUNTERS; i++) {
+        for (value = diag.counters[i]; value >= 0x80; value >>= 7)
+            buf[len++] = (value & 0x7F) | 0x80;
+        buf[len++] = value;
+    }
+    return len;
+}
+
+
+// report has been sent, save counters to flash
+void diag_sent() {
+    requested = false;
+    lastReport = uptime_ms();
+    diag_save();
+    log_info("Diagnostics report sent (awake %ld s, standby %ld s, SDS011 fan %ld s, TX %ld ms, RX %ld ms)",
+        diag.counters[DIAG_AWAKE_MS] / 1000, diag.counters[DIAG_STANDBY_SECS],
+        diag.counters[DIAG_FAN_MS] / 1000, diag.counters[DIAG_TX_MS], diag.counters[DIAG_RX_MS]);
+}
+#endif
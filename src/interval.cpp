@@ -0,0 +1,118 @@
+/***************************************************************************
+  Copyright (c) 2024 Lars Wessels
+
+  This file is part of the "Feather-M0-LoRaWAN-PM-Sensor" source code.
+  https://github.com/lrswss/feather-m0-lorawan-pm-sensor
+
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+   
+  http://www.apache.org/licenses/LICENSE-2.0
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+***************************************************************************/
+
+#include "interval.h"
+#include "utils.h"
+#include "battery.h"
+#include "alert.h"
+#include "settings.h"
+
+#define LOG_MODULE LOG_LEVEL_SENSORS
+
+static uint16_t interval = 0; // settings.interval until first update
+static int16_t lastPm25 = -1, lastPm10 = -1;
+static uint16_t vbatRef = 0;
+
+
+// returns relative change (%) of PM value compared to previous observation
+static uint16_t interval_change(int16_t pm, int16_t last) {
+    uint16_t diff = abs(pm - last);
+
+    if (diff < INTERVAL_CHANGE_MIN * 10)
+        return 0;
+    return (uint32_t)diff * 100 / max(last, INTERVAL_CHANGE_MIN * 10);
+}
+
+
+// returns true if (filtered) battery voltage is dropping
+static bool interval_draining(uint16_t vbat) {
+    if (vbat == 0) { // not connected or charging
+        vbatRef = 0;
+        return false;
+    }
+    if (vbatRef == 0 || vbat > vbatRef)
+        vbatRef = vbat;
+    if ((vbatRef - vbat) < INTERVAL_VBAT_DRAIN_MV)
+        return false;
+    vbatRef = vbat;
+    return true;
+}
+
+
+// adapt observation interval to latest sensor readings; shortened if PM
+// values change quickly, prolonged if PM values are low and stable and even
+// more if battery is draining, otherwise it returns to configured interval
+uint16_t interval_update(sensorReadings_t *readings) {
+    uint16_t change = 0;
+    bool draining = interval_draining(readings->vbat);
+    uint32_t next;
+
+    if (interval == 0)
+        interval = settings.interval;
+    next = interval;
+
+    if ((readings->status & SENSORS_SDS011_ERROR) == 0 && readings->pm25 >= 0) {
+        if (lastPm25 >= 0)
+            change = max(interval_change(readings->pm25, lastPm25), interval_change(readings->pm10, lastPm10));
+        lastPm25 = readings->pm25;
+        lastPm10 = readings->pm10;
+    }
+
+    if (change >= INTERVAL_FAST_PCT) {
+        next = interval / 2;
+    } else if (change <= INTERVAL_STABLE_PCT && readings->pm25 >= 0 && readings->pm25 < INTERVAL_PM25_LOW * 10 &&
+            readings->pm10 < INTERVAL_PM10_LOW * 10) {
+        next = draining ? interval * 2 : interval * 3 / 2;
+    } else if (draining) {
+        next = interval * 3 / 2;
+    } else if (interval > settings.interval) {
+        next = max(interval * 2 / 3, settings.interval);
+    } else if (interval < settings.interval) {
+        next = min(interval * 3 / 2, settings.interval);
+    }
+
+    next = constrain(next, OBSERVATION_INTERVAL_MIN_SECS, OBSERVATION_INTERVAL_MAX_SECS);
+    if (next != interval)
+        log_info("Changing observation interval from %d to %d secs (PM change %d%%%s)",
+            interval, next, change, draining ? ", battery draining" : "");
+    interval = next;
+    readings->interval = interval_current();
+    return readings->interval;
+}
+
+
+// returns current observation interval in seconds, shortened in
+// alert state (see alert_interval()) and stretched if battery is low
+// (see battery_interval())
+uint16_t interval_current() {
+    uint16_t current = interval ? interval : settings.interval;
+
+#ifdef PM_ALERTS
+    return battery_interval(alert_interval(current));
+#else
+    return battery_interval(current);
+#endif
+}
+
+
+// return to configured interval (settings.interval), e.g. after it was changed
+void interval_reset() {
+    interval = 0;
+}
@@ -0,0 +1,157 @@
+/***************************************************************************
+  Copyright (c) 2024 Lars Wessels
+
+  This file is part of the "Feather-M0-LoRaWAN-PM-Sensor" source code.
+  https://github.com/lrswss/feather-m0-lorawan-pm-sensor
+
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+   
+  http://www.apache.org/licenses/LICENSE-2.0
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+***************************************************************************/
+
+#include "logsink.h"
+#include "config.h"
+
+#if defined(LOG_DMA) && defined(SERIAL_BAUD)
+LogSink logSink;
+
+static uint8_t ring[LOGSINK_BUFFER_SIZE];
+static volatile uint16_t head = 0, tail = 0;
+static volatile uint16_t chunk = 0; // bytes in current DMA transfer
+static volatile bool sent = false; // bytes transmitted since last flush()
+static uint32_t dropped = 0;
+static uint32_t flushMs = 0; // max. time to transmit a full ring buffer
+
+static DmacDescriptor descriptor __attribute__((aligned(16)));
+static DmacDescriptor writeback __attribute__((aligned(16)));
+
+
+// transfer contiguous bytes from ring buffer to UART (if
+// DMA channel is idle), must be called with interrupts disabled
+static void logsink_start() {
+    if (chunk > 0 || head == tail)
+        return;
+
+    chunk = (head > tail ? head : LOGSINK_BUFFER_SIZE) - tail;
+    descriptor.SRCADDR.reg = (uintptr_t)(ring + tail + chunk); // end address
+    descriptor.BTCNT.reg = chunk;
+    DMAC->CHID.reg = DMAC_CHID_ID(LOGSINK_DMA_CHANNEL);
+    DMAC->CHCTRLA.reg |= DMAC_CHCTRLA_ENABLE;
+    sent = true;
+}
+
+
+// DMA transfer completed, continue with remaining bytes (if any)
+void DMAC_Handler() {
+    DMAC->CHID.reg = DMAC_CHID_ID(LOGSINK_DMA_CHANNEL);
+    if (DMAC->CHINTFLAG.reg & DMAC_CHINTFLAG_TCMPL) {
+        DMAC->CHINTFLAG.reg = DMAC_CHINTFLAG_TCMPL;
+        tail = (tail + chunk) % LOGSINK_BUFFER_SIZE;
+        chunk = 0;
+        logsink_start();
+    }
+}
+
+
+// setup Serial1 (baud rate, pins) and DMA channel writing
+// to its data register whenever it is ready for the next byte
+void LogSink::begin(unsigned long baud) {
+    Serial1.begin(baud);
+    flushMs = LOGSINK_BUFFER_SIZE * 10000UL / baud + LOGSINK_FLUSH_MARGIN_MS; // 10 bits per byte
+
+    PM->AHBMASK.reg |= PM_AHBMASK_DMAC;
+    PM->APBBMASK.reg |= PM_APBBMASK_DMAC;
+    DMAC->CTRL.reg &= ~DMAC_CTRL_DMAENABLE;
+    DMAC->CTRL.reg = DMAC_CTRL_SWRST;
+    while (DMAC->CTRL.reg & DMAC_CTRL_SWRST);
+    DMAC->BASEADDR.reg = (uintptr_t)&descriptor;
+    DMAC->WRBADDR.reg = (uintptr_t)&writeback;
+    DMAC->CTRL.reg = DMAC_CTRL_DMAENABLE | DMAC_CTRL_LVLEN(0xF);
+
+    DMAC->CHID.reg = DMAC_CHID_ID(LOGSINK_DMA_CHANNEL);
+    DMAC->CHCTRLA.reg = DMAC_CHCTRLA_SWRST;
+    while (DMAC->CHCTRLA.reg & DMAC_CHCTRLA_SWRST);
+    DMAC->CHCTRLB.reg = DMAC_CHCTRLB_LVL(0) | DMAC_CHCTRLB_TRIGSRC(LOGSINK_DMA_TRIGGER) |
+        DMAC_CHCTRLB_TRIGACT_BEAT;
+    DMAC->CHINTENSET.reg = DMAC_CHINTENSET_TCMPL;
+
+    descriptor.BTCTRL.reg = DMAC_BTCTRL_VALID | DMAC_BTCTRL_BEATSIZE_BYTE |
+        DMAC_BTCTRL_SRCINC | DMAC_BTCTRL_BLOCKACT_NOACT;
+    descriptor.DSTADDR.reg = (uintptr_t)&LOGSINK_SERCOM->USART.DATA.reg;
+    descriptor.DESCADDR.reg = 0;
+
+    NVIC_ClearPendingIRQ(DMAC_IRQn);
+    NVIC_SetPriority(DMAC_IRQn, 3);
+    NVIC_EnableIRQ(DMAC_IRQn);
+}
+
+
+size_t LogSink::write(uint8_t c) {
+    return this->write(&c, 1);
+}
+
+
+// copy bytes into ring buffer and start DMA transfer, drops
+// all bytes if there's not enough space left in ring buffer
+size_t LogSink::write(const uint8_t *buf, size_t len) {
+    uint16_t used, n;
+
+    noInterrupts();
+    used = (head + LOGSINK_BUFFER_SIZE - tail) % LOGSINK_BUFFER_SIZE;
+    interrupts();
+    if (len > (size_t)(LOGSINK_BUFFER_SIZE - 1 - used)) {
+        dropped += len;
+        return 0;
+    }
+
+    // copy up to end of ring buffer, then wrap around
+    n = min(len, (size_t)(LOGSINK_BUFFER_SIZE - head));
+    memcpy(ring + head, buf, n);
+    memcpy(ring, buf + n, len - n);
+
+    noInterrupts();
+    head = (head + len) % LOGSINK_BUFFER_SIZE;
+    logsink_start();
+    interrupts();
+    return len;
+}
+
+
+// wait until all buffered bytes have been transmitted, required before
+// standby since DMA controller and SERCOM0 are stopped then; gives up after
+// the time required for a full ring buffer, remaining bytes are dropped
+void LogSink::flush() {
+    uint32_t start = millis();
+
+    while (head != tail || chunk > 0 || (sent && !LOGSINK_SERCOM->USART.INTFLAG.bit.TXC)) {
+        if ((millis() - start) > flushMs) {
+            noInterrupts();
+            DMAC->CHID.reg = DMAC_CHID_ID(LOGSINK_DMA_CHANNEL);
+            DMAC->CHCTRLA.reg &= ~DMAC_CHCTRLA_ENABLE;
+            dropped += (head + LOGSINK_BUFFER_SIZE - tail) % LOGSINK_BUFFER_SIZE;
+            tail = head;
+            chunk = 0;
+            interrupts();
+            break;
+        }
+    }
+    sent = false;
+}
+
+
+// returns number of bytes dropped since last call
+uint32_t LogSink::overflows() {
+    uint32_t n = dropped;
+    dropped = 0;
+    return n;
+}
+#endif
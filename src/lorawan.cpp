@@ -23,9 +23,21 @@
 #include "sensors.h"
 #include "utils.h"
 #include "rtc.h"
+#include "payload.h"
+#include "obslog.h"
+#include "session.h"
+#include "airtime.h"
+#include "battery.h"
+#include "diag.h"
+#include "settings.h"
+#include "alert.h"
+#include "profile.h"
+
+#define LOG_MODULE LOG_LEVEL_LORAWAN
 
 osjob_t observMsg;
 lmic_states lmic_status = NONE;
+static void (*statusCallback)() = NULL;
 
 const lmic_pinmap lmic_pins = {
     .nss = LORA_PIN_NSS,
@@ -38,6 +50,25 @@ const lmic_pinmap lmic_pins = {
 };
 
 
+#ifdef LORAWAN_STORE_FORWARD
+// flash log pages of observations in current frame and of unconfirmed
+// frames sent since last ack, marked as sent once a confirmed frame
+// has been acknowledged (see lmic_txacked())
+static uint16_t txPages[PAYLOAD_BUFFER_SIZE];
+static uint8_t txPagesCount = 0;
+static bool txConfirmed = false;
+static uint16_t ackPages[LORAWAN_ACK_PAGES];
+static uint8_t ackPagesCount = 0;
+static uint32_t lastConfirmed = 0;
+static bool lastAcked = true;
+static uint16_t obsPage = 0;
+static uint32_t lastReplay = 0;
+#endif
+
+#ifdef DIAGNOSTICS
+static bool txDiag = false; // diagnostics report in current frame
+#endif
+
 // LoRaWAN OTAA keys are (pre)set in lorawan.h
 static const uint8_t DEVEUI[8] = LORAWAN_DEV_EUI;
 static const uint8_t APPEUI[8] = LORAWAN_APP_EUI;
@@ -76,6 +107,9 @@ static char* lmic_version() {
 static void print_otaa_data() {
     uint8_t buf[16];
 
+    if (!LOG_ENABLED(LOG_DEBUG))
+        return;
+
     os_getDevEui(buf);
     serial.print("Device EUI: "); // stored in flash, cannot be changed
     print_hex(buf, sizeof(DEVEUI), true, true);
@@ -91,6 +125,8 @@ static void print_otaa_data() {
 
 // print temporary session keys
 static void print_session_keys() {
+    if (!LOG_ENABLED(LOG_DEBUG))
+        return;
     serial.printf("Netid: 0x%0X%s\n",
         (LMIC.netid & 0x001FFFFF), LMIC.netid == 0x13 ? " (TTN)" : "");
     serial.printf("Device Address: %06X\n", LMIC.devaddr);
@@ -109,24 +145,34 @@ static void print_session_keys() {
 static void networkTimeCallback(void *pUserData, int success) {
     uint32_t *ts_sec = (uint32_t *)pUserData;
     lmic_time_reference_t lmicTimeRef;
+#ifdef RTC_CALIBRATION
+    uint32_t delayMs;
+#endif
 
     if (success != 1) {
-        log_msg("networkTimeCallback() failed!");
+        log_error("networkTimeCallback() failed!");
         return;
     } else if (LMIC_getNetworkTimeReference(&lmicTimeRef) != 1) {
-        log_msg("LMIC_getNetworkTimeReference failed!");
+        log_error("LMIC_getNetworkTimeReference failed!");
         return;
     }
 
     // adjust network time (based on GPS epoch) to UTC
     *ts_sec = lmicTimeRef.tNetwork + 315964800 - 18;
 
+#ifdef RTC_CALIBRATION
+    // add delay since end of uplink and fraction of network time (1/256 secs)
+    delayMs = osticks2ms(os_getTime() - lmicTimeRef.tLocal) + LMIC.netDeviceTimeFrac * 1000UL / 256;
+    *ts_sec += delayMs / 1000;
+    rtc_sync(*ts_sec, delayMs % 1000);
+#else
     // add delay since time request was sent
     *ts_sec += osticks2ms(os_getTime() - lmicTimeRef.tLocal) / 1000;
 
     // set RTC
     rtc.setEpoch(*ts_sec);
-    log_msg("Set RTC to LoRaWAN network time");
+    log_info("Set RTC to LoRaWAN network time");
+#endif
 }
 #endif
 
@@ -140,126 +186,283 @@ static void lmic_remove(osjob_t* j) {
 }
 
 
-// wait for pending LoRaWAN jobs (TXRX/JOIN)
-static void lmic_pending_jobs(uint16_t waitSecs) {
-    uint32_t wait = 0;
-    bool once = false;
+// returns true if LMIC has no pending transmission or join and no jobs
+// are due within given number of seconds, so MCU can go to standby
+// (LMIC's clock stops in standby, pending jobs would be delayed)
+bool lmic_idle(uint16_t secs) {
+    os_runloop_once();
+    return !(LMIC.opmode & (OP_TXRXPEND|OP_JOINING)) &&
+        !os_queryTimeCriticalJobs(sec2osticks(secs));
+}
 
-    while ((LMIC.opmode & (OP_TXRXPEND|OP_JOINING)) || os_queryTimeCriticalJobs(ms2osticks(waitSecs*1000))) {
-        if (!once) {
-            log_msg("LoRaWAN jobs pending, waiting for completion...");
-            once = true;
-        }
-        if (wait > (waitSecs * 1000))
-            break;
-        os_runloop_once();
-        delay(1);
+
+// difference of two LMIC times, computed unsigned like LMIC's hal_checkTimer()
+// since LMIC's clock wraps around (signed overflow is undefined)
+static ostime_t lmic_diff(ostime_t a, ostime_t b) {
+    return (ostime_t)((u4_t)a - (u4_t)b);
+}
+
+
+// move given LMIC time by given ticks towards now (not beyond)
+static void lmic_shift(ostime_t *avail, ostime_t now, ostime_t ticks) {
+    ostime_t left = lmic_diff(*avail, now);
+
+    if (left > 0)
+        *avail = (ostime_t)((u4_t)now + (u4_t)(left > ticks ? left - ticks : 0));
+}
+
+
+// LMIC's clock stops in standby, so duty cycle limits would be extended by
+// the time spent in standby (LMIC waits with its clock running, i.e. awake,
+// e.g. about 2.5 minutes after each uplink at SF12); shift them accordingly
+void lmic_standby(uint32_t ms) {
+    ostime_t now = os_getTime(), ticks;
+
+    ticks = ms2osticks(min(ms, 3600000UL)); // max. 1 h, ostime_t is 32 bits
+    lmic_shift(&LMIC.globalDutyAvail, now, ticks);
+#if CFG_LMIC_EU_like
+    for (uint8_t i = 0; i < MAX_BANDS; i++)
+        lmic_shift(&LMIC.bands[i].avail, now, ticks);
+#endif
+}
+
+
+// returns ms until LMIC's duty cycle limits allow the next uplink
+// (0 if it can be sent now), see lmic_standby()
+uint32_t lmic_txwait() {
+    ostime_t now = os_getTime(), avail = LMIC.globalDutyAvail;
+#if CFG_LMIC_EU_like
+    ostime_t bandAvail = 0;
+    bool found = false;
+
+    // earliest available band with an enabled channel (band in bits 0-1)
+    for (uint8_t ch = 0; ch < MAX_CHANNELS; ch++) {
+        if (!(LMIC.channelMap & (1 << ch)) || LMIC.channelFreq[ch] == 0)
+            continue;
+        if (!found || lmic_diff(LMIC.bands[LMIC.channelFreq[ch] & 0x3].avail, bandAvail) < 0)
+            bandAvail = LMIC.bands[LMIC.channelFreq[ch] & 0x3].avail;
+        found = true;
     }
+    if (found && lmic_diff(bandAvail, avail) > 0)
+        avail = bandAvail;
+#endif
+    return (lmic_diff(avail, now) > 0) ? osticks2ms(lmic_diff(avail, now)) : 0;
 }
 
 
-// start OTAA join
-bool lmic_join(uint8_t repeat) {
-    static uint8_t joinCounter = 0;
+// set function to be called by LMIC event handler whenever a transmission
+// or join has been completed or failed (status JOINED, TXDONE, NOTJOINED or ERROR)
+void lmic_notify(void (*func)()) {
+    statusCallback = func;
+}
+
+
+// change status in event handler and call notify function (if any)
+static void lmic_set_status(lmic_states status) {
+    lmic_status = status;
+    if (statusCallback != NULL && (status == JOINED || status >= TXDONE))
+        statusCallback();
+}
+
 
+// start OTAA join attempt (if not joined yet), the result is reported with
+// status JOINED or NOTJOINED; data rate is lowered with every attempt
+// (SF7, SF8, ...) since each attempt restarts LMIC's join procedure
+bool lmic_join(uint8_t attempt) {
     if (LMIC.devaddr != 0)
         return true;
 
-    if (joinCounter >= repeat) {
-        log_msg("Canceling LoRaWAN join, already tried %d times in this session!", repeat);
-        lmic_status = NOTJOINED;
-        joinCounter = 0;
-        return false;
-    }
+    log_info("Joining network (attempt %d)...", attempt + 1);
+#ifdef LORAWAN_PERSIST_SESSION
+    session_joining(); // DevNonce in flash ahead of the one used
+#endif
+    LMIC_startJoining();
+    LMIC_setDrTxpow(attempt < DR_SF7 ? DR_SF7 - attempt : DR_SF12, KEEP_TXPOW);
+    return false;
+}
 
-    for (joinCounter = 0; (joinCounter < repeat && LMIC.devaddr == 0); joinCounter++) {
-        log_msg("Joining network...");
-        LMIC_startJoining();
-        lmic_pending_jobs(20);  // wait for join to complete
-    }
 
-    return (LMIC.devaddr != 0);
+// stop LMIC from repeating a failed join request on its own, so the
+// MCU can go to standby until the next attempt (DevNonce and duty cycle
+// limits are kept)
+void lmic_join_cancel() {
+    u2_t devNonce = LMIC.devNonce;
+#if CFG_LMIC_EU_like
+    band_t bands[MAX_BANDS];
+#endif
+
+    if (LMIC.devaddr != 0 || !(LMIC.opmode & OP_JOINING))
+        return;
+#if CFG_LMIC_EU_like
+    memcpy(bands, LMIC.bands, sizeof(bands)); // keep duty cycle limits
+#endif
+    LMIC_reset();
+    LMIC_setClockError(MAX_CLOCK_ERROR * LORAWAN_CLOCK_ERROR_PCT / 100);
+    LMIC.devNonce = devNonce;
+#if CFG_LMIC_EU_like
+    memcpy(LMIC.bands, bands, sizeof(bands));
+#endif
+    log_debug("Canceled pending LoRaWAN join");
+}
+
+
+#if defined(LORAWAN_BATCH_SIZE) || defined(LORAWAN_STORE_FORWARD)
+// max. application payload size for EU868 data rates DR0 (SF12) to DR5 (SF7)
+static const uint8_t maxPayloadSize[] = { 51, 51, 51, 115, 222, 222 };
+
+// returns max. size for batch frame at current data rate
+// (reduced by size of pending MAC commands sent as FOpts)
+static uint8_t lmic_maxpayload(uint8_t bufsize) {
+    uint8_t maxlen = LMIC.datarate < sizeof(maxPayloadSize) ? maxPayloadSize[LMIC.datarate] : maxPayloadSize[0];
+    maxlen = min(maxlen, sizeof(LMIC.pendTxData)); // LMIC's buffer (MAX_LEN_FRAME)
+    return min(maxlen - LMIC.pendMacLen, bufsize);
 }
+#endif
 
 
 static void lmic_txdata(osjob_t* j) {
-    uint8_t i = 1, rc = 0;
-    static uint8_t payload[48];
-    static char buf[48];
-    uint16_t payloadValInt;
+    PROFILE(PROFILE_LMIC_TXDATA);
+    uint8_t len = 0, rc = 0, port = 1;
+    static uint8_t payload[128];
 #ifdef LORAWAN_NETWORKTIME
-    uint32_t networkTimeEpoch;
+    static uint32_t networkTimeEpoch; // set by callback after TX/RX has completed
 #endif
 
     if (LMIC.opmode & OP_TXRXPEND) {
-        log_msg("LMIC is busy, remove scheduled TX job!");
+        log_warn("LMIC is busy, remove scheduled TX job!");
         lmic_remove(j);
         return;
     } else {
-        memset(buf, 0, sizeof(buf));
-        sprintf(buf, "Preparing LoRaWAN packet %ld", LMIC.seqnoUp+1);
-
         // request time from LoRaWAN gateway using MAC command DeviceTimeReq
 #ifdef LORAWAN_NETWORKTIME
+#ifdef RTC_CALIBRATION
+        if (rtc_sync_due()) {
+#else
         if (LMIC.seqnoUp % 30 == 0) {
+#endif
             LMIC_requestNetworkTime(networkTimeCallback, &networkTimeEpoch);
-            strcat(buf, " (with network time request)");
-        }
+            log_info("Preparing LoRaWAN packet %ld (with network time request)", LMIC.seqnoUp+1);
+        } else
+#endif
+        log_info("Preparing LoRaWAN packet %ld", LMIC.seqnoUp+1);
+
+#ifdef LORAWAN_BATCH_SIZE
+        uint8_t records = 0;
+        len = payload_batch(payload, lmic_maxpayload(sizeof(payload)), rtc.getEpoch(), &records);
+        port = 2;
+        log_info("Sending %d of %d buffered observations (%d bytes)", records, payload_pending(), len);
+#else
+        len = payload_encode(payload, LORAWAN_PAYLOAD_VERSION, &sensorReadings);
 #endif
-        log_msg(buf);
-
-        memset(payload, 0, sizeof(payload));
-        payload[0] = LORAWAN_PAYLOAD_VERSION; // 1
-
-        // sensor sensors status
-        payload[i++] = sensorReadings.status; // 2
-
-#ifdef VBAT_PIN
-        if (sensorReadings.vbat > 2.55) {
-            payload[i++] = 0x01;  // V
-            payload[i++] = byte((int)(sensorReadings.vbat * 100) - 256);
-        } // 4
-#endif
-        if ((sensorReadings.status & SENSORS_I2C_FAILED) == 0) {
-            payloadValInt = (int)(sensorReadings.temperature * 100);
-            payload[i++] = 0x10; // degree celcius
-            payload[i++] = (payloadValInt >> 8) & 0xff;
-            payload[i++] = payloadValInt & 0xff;
-            payload[i++] = 0x11; // %
-            payload[i++] = sensorReadings.humidity;
-        } // 9
-
-        if (sensorReadings.status & SENSORS_HAS_BME280) {
-            payloadValInt = (int)(sensorReadings.pressure * 10);
-            payload[i++] = 0x12; // hPa
-            payload[i++] = (payloadValInt >> 8) & 0xff;
-            payload[i++] = payloadValInt & 0xff;
-        } // 12
-
-        if ((sensorReadings.status & SENSORS_SDS011_ERROR) == 0) {
-            payloadValInt = (int)(sensorReadings.pm25 * 10);
-            payload[i++] = 0x50; // μg/m3
-            payload[i++] = (payloadValInt >> 8) & 0xff;
-            payload[i++] = payloadValInt & 0xff;
-            payloadValInt = (int)(sensorReadings.pm10 * 10);
-            payload[i++] = 0x51; // μg/m3
-            payload[i++] = (payloadValInt >> 8) & 0xff;
-            payload[i++] = payloadValInt & 0xff;
-        } // 18
 
         // queue payload for transmission
         blink_led(250, 1);
         delay(500);
-        rc = LMIC_setTxData2(1, payload, i, 0); // port 0
+#ifdef LORAWAN_STORE_FORWARD
+        txConfirmed = (rtc.getEpoch() - lastConfirmed) >= LORAWAN_CONFIRM_SECS ||
+            ackPagesCount > LORAWAN_ACK_PAGES - PAYLOAD_BUFFER_SIZE;
+        rc = LMIC_setTxData2(port, payload, len, txConfirmed);
+#else
+        rc = LMIC_setTxData2(port, payload, len, 0);
+#endif
         lmic_remove(j);
         if (rc != LMIC_ERROR_SUCCESS) {
             blink_led(100, 4);
-            log_msg("LoRaWAN TX failed with error %d!", rc);
+            log_error("LoRaWAN TX failed with error %d!", rc);
+#ifdef LORAWAN_STORE_FORWARD
+            txConfirmed = false;
+#endif
+            lmic_set_status(ERROR); // don't wait for EV_TXCOMPLETE
+        }
+        else {
+#ifdef LORAWAN_BATCH_SIZE
+#ifdef LORAWAN_STORE_FORWARD
+            for (txPagesCount = 0; txPagesCount < records; txPagesCount++)
+                txPages[txPagesCount] = payload_tag(txPagesCount);
+#endif
+            payload_drop(records);
+#elif defined(LORAWAN_STORE_FORWARD)
+            txPages[0] = obsPage;
+            txPagesCount = 1;
+#endif
         }
     }
 }
 
 
+#ifdef DIAGNOSTICS
+// send diagnostics counters
+static void lmic_txdiag(osjob_t* j) {
+    uint8_t payload[DIAG_MAX_SIZE], len, rc;
+
+    if (LMIC.opmode & OP_TXRXPEND) {
+        log_warn("LMIC is busy, remove scheduled TX job!");
+        lmic_remove(j);
+        return;
+    }
+
+    len = diag_encode(payload);
+    log_info("Sending diagnostics report (%d bytes)", len);
+    rc = LMIC_setTxData2(DIAG_PORT, payload, len, 0);
+    lmic_remove(j);
+    if (rc != LMIC_ERROR_SUCCESS) {
+        blink_led(100, 4);
+        log_error("LoRaWAN TX failed with error %d!", rc);
+        lmic_set_status(ERROR);
+    } else {
+        txDiag = true;
+    }
+}
+
+
+// account estimated time in receive windows after uplink with given RX1
+// delay (ms): RX1 until end of downlink received in given window (1/2) with
+// given length, otherwise RX1 and RX2 (opened one second later); windows
+// are widened by LORAWAN_CLOCK_ERROR_PCT (see lmic_init())
+static void lmic_rxtime(uint32_t delay, uint8_t window, uint8_t len) {
+    uint8_t rx1Dr = LMIC.datarate - min(LMIC.rx1DrOffset, LMIC.datarate);
+    uint32_t ms;
+
+    ms = airtime_rx_ms(rx1Dr, delay * LORAWAN_CLOCK_ERROR_PCT / 100, window == 1 ? len : 0);
+    if (window != 1)
+        ms += airtime_rx_ms(LMIC.dn2Dr, (delay + 1000) * LORAWAN_CLOCK_ERROR_PCT / 100,
+            window == 2 ? len : 0);
+    diag_add(DIAG_RX_MS, ms);
+}
+#endif
+
+
+#ifdef LORAWAN_STORE_FORWARD
+// send oldest observations from flash log which have not been sent yet
+static void lmic_txbacklog(osjob_t* j) {
+    static uint8_t payload[128];
+    uint8_t len, rc, records;
+
+    if (LMIC.opmode & OP_TXRXPEND) {
+        log_warn("LMIC is busy, remove scheduled TX job!");
+        lmic_remove(j);
+        return;
+    }
+
+    // oldest observations first, the latest ones are waiting for an ack
+    len = obslog_backlog(payload, lmic_maxpayload(sizeof(payload)), rtc.getEpoch(),
+        txPages, min(obslog_pending() - ackPagesCount, PAYLOAD_BUFFER_SIZE), &records);
+    log_info("Sending %d of %d observations from flash log (%d bytes)", records, obslog_pending(), len);
+    txConfirmed = true;
+    rc = LMIC_setTxData2(3, payload, len, 1);
+    lmic_remove(j);
+    if (rc != LMIC_ERROR_SUCCESS) {
+        blink_led(100, 4);
+        log_error("LoRaWAN TX failed with error %d!", rc);
+        txConfirmed = false;
+        lmic_set_status(ERROR);
+    } else {
+        txPagesCount = records;
+    }
+}
+#endif
+
+
 // returns given datarate as string (SF7-SF12)
 static void dr2str(uint8_t dr, char *drstr) {
     switch (dr) {
@@ -280,14 +483,14 @@ static void dr2str(uint8_t dr, char *drstr) {
 // ADR status and ACK settings on current LoRaWAN transmission
 static char* lmic_txinfo() {
     static char txinfo[48];
-    char buf[8];
+    char buf[12];
 
     memset(txinfo, 0, sizeof(txinfo));
     if (LMIC.seqnoUp == 0)
         sprintf(txinfo, "tx,join,");
     else
         sprintf(txinfo, "tx,%ld,", LMIC.seqnoUp);
-    dtostrf(LMIC.freq / 1000000.0, 5, 1, buf);
+    fixstr(buf, LMIC.freq / 100000, 1);
     strcat(txinfo, buf);
     strcat(txinfo,",");
     itoa(LMIC.pendTxPort, buf, 10);  // port
@@ -317,11 +520,11 @@ static char* lmic_txinfo() {
 // returns string with freq, datarate, payload size of last LoRaWAN reception
 static char* lmic_rxinfo() {
     static char rxinfo[48];
-    char buf[8];
+    char buf[12];
 
     memset(rxinfo, 0, sizeof(rxinfo));
     sprintf(rxinfo, "rx%d,%ld,", (LMIC.txrxFlags & TXRX_DNW1) ? 1 : 2, LMIC.seqnoDn);
-    dtostrf(LMIC.freq / 1000000.0, 5, 1, buf);
+    fixstr(buf, LMIC.freq / 100000, 1);
     strcat(rxinfo, buf);
     strcat(rxinfo,",");
     itoa(LMIC.frame[LMIC.dataBeg-1], buf, 10); // port (if present)
@@ -350,120 +553,191 @@ static char* lmic_rxinfo() {
 // compiler errors before setting this option!
 uint8_t os_getBattLevel() {
 #if defined(LORAWAN_MAC_BATLEVEL) && defined(VBAT_PIN)
-    char buf[8];
-    double vbat = (analogRead(VBAT_PIN) * VBAT_MULTIPLIER * 3.3) / 1024;
-    if (vbat < VBAT_MIN_LEVEL) {
-        Serial.println("1)");
-        return 1;
-    } else if (vbat > VBAT_MAX_LEVEL) {
-        Serial.println("0)");
-        return 0;
-    } else if (vbat >= VBAT_MIN_LEVEL && vbat <= VBAT_MAX_LEVEL) {
-        dtostrf(vbat, 4, 2, buf);
-        // remap Li-Ion battery voltage to 1-254
-        uint8_t batLevel = (uint8_t) mapfloat(vbat,
-            VBAT_MIN_LEVEL, VBAT_MAX_LEVEL, MCMD_DEVS_BATT_MIN, MCMD_DEVS_BATT_MAX);
-        log_msg("LNS requesting battery level (%sV -> %d", buf, batLevel);    
-        return batLevel;
-    } else
-#endif
+    uint8_t batLevel = battery_level();
+    log_debug("LNS requesting battery level (%d mV, %d%% -> %d)", battery_mv(), battery_soc(), batLevel);
+    return batLevel;
+#else
     return 255;
+#endif
+}
+
+
+#ifdef LORAWAN_STORE_FORWARD
+// transmission completed: observations of a confirmed frame and of the
+// unconfirmed frames sent before are marked as sent if it has been
+// acknowledged, otherwise they are kept in flash log and sent again
+static void lmic_txacked(bool acked) {
+    if (!txConfirmed) {
+        while (txPagesCount > 0 && ackPagesCount < LORAWAN_ACK_PAGES)
+            ackPages[ackPagesCount++] = txPages[--txPagesCount];
+        txPagesCount = 0;
+        return;
+    }
+    if (acked) {
+        while (txPagesCount > 0)
+            obslog_sent(txPages[--txPagesCount]);
+        while (ackPagesCount > 0)
+            obslog_sent(ackPages[--ackPagesCount]);
+    } else if (txPagesCount + ackPagesCount > 0) {
+        log_warn("[WARNING] No ACK, keeping %d observations in flash log", txPagesCount + ackPagesCount);
+    }
+    txPagesCount = ackPagesCount = 0;
+    txConfirmed = false;
+    lastConfirmed = rtc.getEpoch();
+    lastAcked = acked;
+}
+#endif
+
+
+// settings applied after join or restoring a saved session
+static void lmic_session_setup() {
+#ifndef LORAWAN_ADR
+    LMIC_setAdrMode(0);
+    log_info("ADR disabled");
+#endif
+#ifndef LORAWAN_LINK_CHECK
+    // Disable link check validation (automatically enabled during join)
+    // https://forum.mcci.io/t/lmic-setlinkcheckmode-questions/96
+    // might eventually lead to EV_LINK_DEAD if there a no frequent DL messages
+    LMIC_setLinkCheckMode(0);
+    log_info("LinkCheckMode disabled");
+#endif
 }
 
 
 // process LMIC events
 void onEvent (ev_t ev) {
+    PROFILE(PROFILE_ON_EVENT);
     static uint32_t txStartMillis = 0;
+    static bool firstUplink = true;
 
     switch(ev) {
         case EV_JOINING:
-            log_msg("Start joining network...");
+            log_info("Start joining network...");
             print_otaa_data();
             break;
         case EV_JOINED:
-            log_msg("Successfully joined network (%ld ms, RSSI: %d dbm, SNR: %d db)",
+            log_info("Successfully joined network (%ld ms, RSSI: %d dbm, SNR: %d db)",
                 (millis() - txStartMillis), (LMIC.rssi - RSSI_OFF), ((LMIC.snr+2)/4));
             txStartMillis = 0;
             print_session_keys();
             blink_led(200, 2);
-#ifndef LORAWAN_ADR
-            LMIC_setAdrMode(0);
-            log_msg("ADR disabled");
+            lmic_session_setup();
+#ifdef LORAWAN_PERSIST_SESSION
+            session_save();
 #endif
-#ifndef LORAWAN_LINK_CHECK
-            // Disable link check validation (automatically enabled during join)
-            // https://forum.mcci.io/t/lmic-setlinkcheckmode-questions/96
-            // might eventually lead to EV_LINK_DEAD if there a no frequent DL messages
-            LMIC_setLinkCheckMode(0);
-            log_msg("LinkCheckMode disabled");
+#ifdef DIAGNOSTICS
+            lmic_rxtime(DELAY_JACC1 * 1000UL, 1, LEN_JA);
 #endif
-            lmic_status = JOINED;
+            lmic_set_status(JOINED);
             break;
         case EV_JOIN_FAILED:
-            log_msg("EV_JOIN_FAILED");
-            lmic_status = NOTJOINED;
+            log_error("EV_JOIN_FAILED");
+            lmic_set_status(NOTJOINED);
             blink_led(100, 5);
             break;
         case EV_REJOIN_FAILED:
-            log_msg("EV_REJOIN_FAILED");
-            lmic_status = NOTJOINED;
+            log_error("EV_REJOIN_FAILED");
+            lmic_set_status(NOTJOINED);
             blink_led(100, 5);
             break;
         case EV_TXCOMPLETE:
             if ((LMIC.txrxFlags & (TXRX_DNW1|TXRX_DNW2)) != 0) {
-                log_msg("TX/RX completed (%ld ms, RSSI: %d dbm, SNR: %d db)",
-                    (millis() - txStartMillis), LMIC.rssi - RSSI_OFF), ((LMIC.snr+2)/4);
+                log_info("TX/RX completed (%ld ms, RSSI: %d dbm, SNR: %d db)",
+                    (millis() - txStartMillis), (LMIC.rssi - RSSI_OFF), ((LMIC.snr+2)/4));
             } else {
-                log_msg("TX/RX completed (%ld ms)", (millis() - txStartMillis));
+                log_info("TX/RX completed (%ld ms)", (millis() - txStartMillis));
             }
 
             if ((LMIC.txrxFlags & (TXRX_DNW1|TXRX_DNW2)) != 0) {
                 if ((LMIC.txrxFlags & TXRX_ACK) != 0 && LMIC.dataBeg <= 8)
-                    log_msg("Received ACK (%s)", lmic_rxinfo());
+                    log_info("Received ACK (%s)", lmic_rxinfo());
                 else if ((LMIC.txrxFlags & TXRX_NOPORT) != 0)
-                    log_msg("Received MAC command (%s)", lmic_rxinfo());
+                    log_debug("Received MAC command (%s)", lmic_rxinfo());
                 else
-                    log_msg("Received downlink message (%s)", lmic_rxinfo());
+                    log_info("Received downlink message (%s)", lmic_rxinfo());
                 blink_led(50, 4);
             } else {
                 blink_led(50, 2);
             }
+#ifdef DIAGNOSTICS
+            lmic_rxtime(max(LMIC.rxDelay, 1) * 1000UL, (LMIC.txrxFlags & TXRX_DNW1) ? 1 :
+                ((LMIC.txrxFlags & TXRX_DNW2) ? 2 : 0), LMIC.dataBeg + LMIC.dataLen + 4);
+            if ((LMIC.txrxFlags & TXRX_PORT) && LMIC.frame[LMIC.dataBeg-1] == DIAG_PORT)
+                diag_request();
+            if (txDiag) {
+                diag_sent();
+                txDiag = false;
+            }
+#endif
+#ifdef REMOTE_SETTINGS
+            if ((LMIC.txrxFlags & TXRX_PORT) && LMIC.frame[LMIC.dataBeg-1] == SETTINGS_PORT)
+                settings_downlink(LMIC.frame + LMIC.dataBeg, LMIC.dataLen);
+#endif
             LMIC_clrTxData();
+#ifdef LORAWAN_STORE_FORWARD
+            lmic_txacked((LMIC.txrxFlags & TXRX_ACK) != 0);
+#endif
             // Only switch to status TXDONE if sensor data has actually
             // been queued for transmission with lmic_send().
             // This avoids going to sleep to early after an intermittent
             // LoRaWAN transmissions which can be triggered by LoRaWAN MAC
             // commands from the network server (eg. battery status requests)
             if (lmic_status == TXPENDING)
-                lmic_status = TXDONE;
+                lmic_set_status(TXDONE);
+            else if (lmic_status == ERROR) // link dead, reported after TX
+                lmic_set_status(ERROR);
+#ifdef LORAWAN_PERSIST_SESSION
+            if (lmic_status != ERROR && session_due()) // cleared on link dead
+                session_save();
+#endif
             break;
         case EV_RESET:
-            log_msg("EV_RESET");
+            log_debug("EV_RESET");
             break;
         case EV_RXCOMPLETE:
-            log_msg("EV_RXCOMPLETE");
+            log_debug("EV_RXCOMPLETE");
             break;
         case EV_LINK_DEAD:
-            log_msg("EV_LINK_DEAD");
-            lmic_status = ERROR;
+            log_error("EV_LINK_DEAD");
+            lmic_status = ERROR; // frame is still sent, see EV_TXCOMPLETE
+#ifdef LORAWAN_PERSIST_SESSION
+            session_clear(); // join again after LMIC reset
+#endif
             blink_led(100, 10);
             break;
         case EV_LINK_ALIVE:
-            log_msg("EV_LINK_ALIVE");
-            lmic_status = IDLE;
+            log_debug("EV_LINK_ALIVE"); // session is kept, no recovery required
             break;
         case EV_TXSTART:
-            log_msg("TX started (%s)%s", lmic_txinfo(),
+            log_debug("TX started (%s)%s", lmic_txinfo(),
                 (LMIC.devaddr == 0 ? ", waiting for join to complete..." : ""));
             txStartMillis = millis();
+            if (firstUplink && LMIC.devaddr != 0) {
+                log_info("First uplink %ld ms after startup", uptime_ms());
+                firstUplink = false;
+            }
+#ifdef LORAWAN_AIRTIME_BUDGET
+            airtime_add(airtime_ms(LMIC.datarate, LMIC.dataLen), rtc.getEpoch());
+#endif
+            diag_add(DIAG_TX_MS, airtime_ms(LMIC.datarate, LMIC.dataLen));
+            if (LMIC.devaddr == 0)
+                diag_add(DIAG_JOINS, 1);
+#ifdef LORAWAN_PERSIST_SESSION
+            if (LMIC.devaddr == 0)
+                session_joining(); // LMIC might repeat join requests on its own
+#endif
             break;
         case EV_JOIN_TXCOMPLETE:
-            log_msg("Join not accepted!");
-            lmic_status = NOTJOINED;
+            log_error("Join not accepted!");
+#ifdef DIAGNOSTICS
+            lmic_rxtime(DELAY_JACC1 * 1000UL, 0, 0);
+#endif
+            lmic_set_status(NOTJOINED);
             blink_led(100, 5);
             break;
         default:
-            log_msg("Oops, unknown event: %d", (unsigned)ev);
+            log_warn("Oops, unknown event: %d", (unsigned)ev);
             break;
     }
 }
@@ -471,39 +745,143 @@ void onEvent (ev_t ev) {
 
 // initialize LMIC library
 void lmic_init() {
-    log_msg("Init MCCI LoRaWAN LMIC Library %s", lmic_version());
+    log_debug("Init MCCI LoRaWAN LMIC Library %s", lmic_version());
     os_init();
 
     // resets the MAC state
     // session and pending data transfers will be discarded
     LMIC_reset();
-    LMIC_setClockError(MAX_CLOCK_ERROR * 2 / 100);
+    LMIC_setClockError(MAX_CLOCK_ERROR * LORAWAN_CLOCK_ERROR_PCT / 100);
     lmic_status = IDLE;
+
+#ifdef LORAWAN_PERSIST_SESSION
+    // resume saved session without joining again
+    if (session_restore()) {
+        lmic_session_setup();
+        lmic_status = JOINED;
+    }
+#endif
 }
 
 
 // schedule job to transmit observation data
 void lmic_send() {
-    if (lmic_status == ERROR || lmic_status == IDLE) // try to recover with LMIC reset
-        lmic_init();
-
     // observation data already scheduled?
     if (os_jobIsTimed(&observMsg))
         return;
 
-    if (lmic_join(1)) {
-        log_msg("Scheduling observation data");
+#ifdef LORAWAN_STORE_FORWARD
+    // keep observation in flash log until it has been sent
+    obsPage = obslog_append(&sensorReadings, rtc.getEpoch());
+#endif
+
+#ifdef LORAWAN_BATCH_SIZE
+    // only transmit if enough observations have been buffered
+    // (or immediately in alert state)
+#ifdef LORAWAN_STORE_FORWARD
+    payload_push(&sensorReadings, rtc.getEpoch(), obsPage);
+#else
+    payload_push(&sensorReadings, rtc.getEpoch(), 0);
+#endif
+#ifdef PM_ALERTS
+    if (payload_pending() < LORAWAN_BATCH_SIZE && !alert_active()) {
+#else
+    if (payload_pending() < LORAWAN_BATCH_SIZE) {
+#endif
+        log_info("Buffered observation (%d/%d)", payload_pending(), LORAWAN_BATCH_SIZE);
+        lmic_status = TXDONE;
+        return;
+    }
+#endif
+
+    if (LMIC.devaddr != 0) {
+        log_info("Scheduling observation data");
         os_setTimedCallback(&observMsg, os_getTime() + ms2osticks(500), lmic_txdata);
         lmic_status = TXPENDING;
         blink_led(50, 1);
     } else {
-        log_msg("Skipping LoRaWAN TX, not joined!");
+        log_warn("Skipping LoRaWAN TX, not joined!");
     }
 }
 
 
+// returns observation interval, given secs are stretched if
+// required to stay within airtime limits
+uint16_t lmic_interval(uint16_t secs) {
+#ifdef LORAWAN_AIRTIME_BUDGET
+    return airtime_interval(secs, rtc.getEpoch());
+#else
+    return secs;
+#endif
+}
+
+
 // prepare LMIC stack for sleep state
+// (status ERROR is kept to recover with LMIC reset in next cycle)
 void lmic_clear() {
     lmic_remove(&observMsg);
-    lmic_status = JOINED;
+    if (lmic_status != ERROR)
+        lmic_status = JOINED;
+}
+
+
+#ifdef LORAWAN_STORE_FORWARD
+// store observation in flash log without transmitting it (e.g. not joined)
+void lmic_store() {
+    obslog_append(&sensorReadings, rtc.getEpoch());
+    log_info("Stored observation in flash log (%d unsent)", obslog_pending());
+}
+
+
+// schedule transmission of observations from flash log which could not be
+// sent before; returns false if there is no backlog or last one was sent
+// less than OBSLOG_REPLAY_SECS ago (to save duty cycle)
+bool lmic_replay() {
+    if (obslog_pending() <= ackPagesCount || LMIC.devaddr == 0 || os_jobIsTimed(&observMsg))
+        return false;
+#ifdef LORAWAN_BATCH_SIZE
+    // buffered observations are also unsent in flash log
+    if (payload_pending() > 0)
+        return false;
+#endif
+    if (lastReplay > 0 && (rtc.getEpoch() - lastReplay) < OBSLOG_REPLAY_SECS)
+        return false;
+    // send backlog only if last confirmed frame has been acknowledged
+    if (!lastAcked)
+        return false;
+#ifdef LORAWAN_AIRTIME_BUDGET
+    // estimate airtime for frame of max. size (13 bytes LoRaWAN overhead)
+    if (!airtime_available(airtime_ms(LMIC.datarate, lmic_maxpayload(128) + 13), rtc.getEpoch())) {
+        log_info("Skipping backlog from flash log, airtime budget exhausted");
+        return false;
+    }
+#endif
+
+    lastReplay = rtc.getEpoch();
+    log_info("Scheduling backlog from flash log");
+    os_setTimedCallback(&observMsg, os_getTime() + ms2osticks(500), lmic_txbacklog);
+    lmic_status = TXPENDING;
+    return true;
+}
+#endif
+
+
+#ifdef DIAGNOSTICS
+// schedule transmission of diagnostics counters if report is due or has been
+// requested by downlink; returns false if not due or airtime budget is used up
+bool lmic_diagnostics() {
+    if (!diag_due() || LMIC.devaddr == 0 || os_jobIsTimed(&observMsg))
+        return false;
+#ifdef LORAWAN_AIRTIME_BUDGET
+    if (!airtime_available(airtime_ms(LMIC.datarate, DIAG_MAX_SIZE + 13), rtc.getEpoch())) {
+        log_info("Skipping diagnostics report, airtime budget exhausted");
+        return false;
+    }
+#endif
+
+    log_info("Scheduling diagnostics report");
+    os_setTimedCallback(&observMsg, os_getTime() + ms2osticks(500), lmic_txdiag);
+    lmic_status = TXPENDING;
+    return true;
 }
+#endif
\ No newline at end of file
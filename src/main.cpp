@@ -23,6 +23,193 @@
 #include "sensors.h"
 #include "config.h"
 #include "rtc.h"
+#include "obslog.h"
+#include "interval.h"
+#include "battery.h"
+#include "scheduler.h"
+#include "alert.h"
+#include "diag.h"
+#include "settings.h"
+#include "profile.h"
+
+#define LOG_MODULE LOG_LEVEL_SYSTEM
+
+
+// observation cycle (join, warmup, sample, transmit, sleep) is run as
+// chain of scheduled jobs, MCU sleeps inbetween (see scheduler.h)
+static schedulerTask_t cycleTask;
+static uint32_t cycleStart = 0;
+static bool cycleOffline = false;
+static bool cycleTxPending = false;
+static bool cycleJoinPending = false;
+static uint8_t cycleJoins = 0;
+
+static void cycle_join(osjob_t* j);
+static void cycle_joined(osjob_t* j);
+
+
+// returns true if backlog or diagnostics might be sent after the observation
+static bool cycle_more() {
+#ifdef LORAWAN_STORE_FORWARD
+    if (obslog_pending() > 0)
+        return true;
+#endif
+#ifdef DIAGNOSTICS
+    if (diag_due())
+        return true;
+#endif
+    return false;
+}
+
+
+// wait for next cycle, observation interval is counted from start of
+// current cycle (stretched if required to stay within airtime limits)
+static void cycle_done(osjob_t* j) {
+    uint32_t secs = lmic_interval(interval_current()), elapsed, wait;
+
+    // further uplinks have to wait for the duty cycle (about 2.5 minutes
+    // at SF12), wait in standby since LMIC would wait with the MCU awake
+    wait = lmic_txwait();
+    if (!cycleOffline && lmic_status == TXDONE && wait > 0 && cycle_more()) {
+        log_debug("Waiting %ld ms for duty cycle", wait);
+        scheduler_in(&cycleTask, cycle_done, wait);
+        return;
+    }
+
+#ifdef LORAWAN_STORE_FORWARD
+    // after transmitting sensor readings send observations from
+    // flash log which could not be transmitted before (if any)
+    if (!cycleOffline && lmic_status == TXDONE && lmic_replay()) {
+        blink_led(50, 1);
+        cycleTxPending = true;
+        return;
+    }
+#endif
+#ifdef DIAGNOSTICS
+    // send diagnostics counters if due or requested by downlink
+    if (!cycleOffline && lmic_status == TXDONE && lmic_diagnostics()) {
+        blink_led(50, 1);
+        cycleTxPending = true;
+        return;
+    }
+#endif
+
+    if (!cycleOffline)
+        lmic_clear();
+#ifdef PROFILING
+    static uint16_t cycles = 0;
+    if (++cycles % PROFILE_DUMP_CYCLES == 0)
+        profile_dump();
+#endif
+    elapsed = (uptime_ms() - cycleStart) / 1000;
+    log_info("Next observation in %ld secs", secs > elapsed ? secs - elapsed : 0);
+    scheduler_at(&cycleTask, cycle_join, cycleStart + secs * 1000);
+}
+
+
+// called by LoRaWAN event handler if join or transmission has been completed
+static void cycle_notify() {
+    if (cycleJoinPending && (lmic_status == JOINED || lmic_status == NOTJOINED)) {
+        cycleJoinPending = false;
+        scheduler_in(&cycleTask, cycle_joined, 0);
+        return;
+    }
+    if (!cycleTxPending || lmic_status == JOINED)
+        return;
+    cycleTxPending = false;
+    scheduler_in(&cycleTask, cycle_done, 0);
+}
+
+
+// read sensors as soon as they are ready, transmit (or store) observation
+static void cycle_sample(osjob_t* j) {
+    uint16_t secs;
+
+    if (!sensors_error() && !sensors_ready()) {
+        secs = sensors_warmup_secs();
+        scheduler_in(&cycleTask, cycle_sample, secs > 0 ? secs * 1000UL : SENSORS_POLL_MS);
+        return;
+    }
+
+    if (!sensors_error())
+        sensors_read(true);
+    sensors_off(); // spin down SDS011 to save power
+    vbat_read(true); // without load of SDS011 fan
+#ifdef PM_ALERTS
+    alert_update(&sensorReadings, rtc.getEpoch());
+#endif
+#ifdef ADAPTIVE_INTERVAL
+    interval_update(&sensorReadings);
+#endif
+
+    if (cycleOffline) {
+#ifdef LORAWAN_STORE_FORWARD
+        lmic_store(); // keep observation in flash log
+#endif
+        scheduler_in(&cycleTask, cycle_done, 0);
+        return;
+    }
+#ifdef REMOTE_SETTINGS
+    sensorReadings.settingsAck = settings_ack();
+#endif
+    lmic_send();
+    if (lmic_status == TXPENDING)
+        cycleTxPending = true; // wait for cycle_notify()
+    else
+        scheduler_in(&cycleTask, cycle_done, 0);
+}
+
+
+// warmup sensors (turn on SDS011 fan and laser diode), if not joined
+// the observation is kept in flash log (if enabled)
+static void cycle_warmup(osjob_t* j) {
+    cycleJoins = 0;
+#ifndef LORAWAN_STORE_FORWARD
+    if (cycleOffline) {
+        scheduler_in(&cycleTask, cycle_done, 0);
+        return;
+    }
+#endif
+    sensors_warmup();
+    scheduler_in(&cycleTask, cycle_sample, sensors_warmup_secs() * 1000UL);
+}
+
+
+// join network (if required), result is reported by cycle_notify(); as
+// a job of its own (instead of waiting for the join to complete) so the
+// MCU can go to standby between join attempts
+static void cycle_join(osjob_t* j) {
+    if (cycleJoins == 0) {
+        battery_hibernate();
+        cycleStart = uptime_ms();
+        if (lmic_status == ERROR || lmic_status == IDLE) // recover with LMIC reset
+            lmic_init();
+    }
+    if (!lmic_join(cycleJoins)) {
+        cycleJoins++;
+        cycleJoinPending = true;
+        scheduler_in(&cycleTask, cycle_joined, LORAWAN_JOIN_TIMEOUT_SECS * 1000UL);
+        return;
+    }
+    cycleOffline = false;
+    cycle_warmup(j);
+}
+
+
+// join attempt completed (or timed out), retry after LORAWAN_JOIN_RETRY_SECS;
+// cycle continues offline after LORAWAN_JOIN_ATTEMPTS failed attempts
+static void cycle_joined(osjob_t* j) {
+    cycleJoinPending = false;
+    lmic_join_cancel(); // LMIC would repeat failed join requests on its own
+    if (lmic_status != JOINED && cycleJoins < LORAWAN_JOIN_ATTEMPTS) {
+        scheduler_in(&cycleTask, cycle_join, LORAWAN_JOIN_RETRY_SECS * 1000UL);
+        return;
+    }
+    cycleOffline = (lmic_status != JOINED);
+    if (cycleOffline)
+        log_warn("Not joined after %d attempts, continuing offline", cycleJoins);
+    cycle_warmup(j);
+}
 
 
 void setup() {
@@ -37,44 +224,24 @@ void setup() {
     serial.begin(SERIAL_BAUD);
     while (!serial);
     serial.println();
-    log_msg("Feather M0 LoRaWAN Dust Sensor v%d starting...", FIRMWARE_VERSION);
+    log_info("Feather M0 LoRaWAN Dust Sensor v%d starting...", FIRMWARE_VERSION);
 #endif
-    vbat_read(true);
+    diag_init();
+    settings_init();
+    rtc_sync_init();
     sensors_init();
-    sensors_off(); // spin down SDS011 to save power (~110mA)
+    sensors_off(); // spin down SDS011 to save power (~110mA), also while hibernating
+    vbat_read(true);
+    battery_hibernate(); // avoid brownout during join
+#ifdef LORAWAN_STORE_FORWARD
+    obslog_init();
+#endif
     lmic_init();
+    lmic_notify(cycle_notify);
+    scheduler_in(&cycleTask, cycle_join, 0);
 }
 
 
 void loop() {
-    // after 3 failed join request goto sleep
-    if (!lmic_join(3)) {
-        sensors_off();
-        sleep(OBSERVATION_INTERVAL_SECS);
-
-    // warmup sensors (turn on SDS011 fan and laser diode) after join
-    } else if (lmic_status == JOINED && !(sensorReadings.status & SENSORS_WARMUP)) {
-        sensors_warmup();
-
-    // after transmitting sensor readings goto sleep
-    } else if (lmic_status >= TXDONE) {
-        lmic_clear();
-        sleep(OBSERVATION_INTERVAL_SECS);
-        sensors_warmup(); // warmup sensor afer wakeup
-
-    // report sensor error status
-    } else if (lmic_status < TXPENDING && sensors_error()) {
-        vbat_read(true);
-        lmic_send();
-
-    // if no tranmission is pending and sensors are ready,
-    // read sensor values and trigger transmission
-    } else if (lmic_status < TXPENDING && sensors_ready()) {
-        sensors_read(true);
-        vbat_read(true);
-        sensors_off(); // spin down SDS011 to save power
-        lmic_send();
-    }
-
-    os_runloop_once();
-}
\ No newline at end of file
+    scheduler_run();
+}
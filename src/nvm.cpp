@@ -0,0 +1,83 @@
+/***************************************************************************
+  Copyright (c) 2024 Lars Wessels
+
+  This file is part of the "Feather-M0-LoRaWAN-PM-Sensor" source code.
+  https://github.com/lrswss/feather-m0-lorawan-pm-sensor
+
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+   
+  http://www.apache.org/licenses/LICENSE-2.0
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+***************************************************************************/
+
+#include "nvm.h"
+
+
+// copy data from flash, volatile access prevents the compiler from
+// assuming the zero initialized content of a NVM_AREA()
+void nvm_read(const volatile void *addr, void *data, uint16_t size) {
+    const volatile uint8_t *src = (const volatile uint8_t *)addr;
+    uint8_t *dst = (uint8_t *)data;
+
+    while (size--)
+        *dst++ = *src++;
+}
+
+
+// write data to (erased) flash starting at word aligned address, last word
+// is padded with 0xFF; bytes which are 0xFF leave flash untouched, so a
+// single word of a page can be cleared later without erasing its row
+void nvm_write(const volatile void *addr, const void *data, uint16_t size) {
+    volatile uint32_t *dst = (volatile uint32_t *)addr;
+    const uint8_t *src = (const uint8_t *)data;
+    uint32_t word;
+    uint8_t len;
+
+    NVMCTRL->CTRLB.bit.MANW = 1;
+    while (size) {
+        // clear page buffer (set all bytes to 0xFF)
+        NVMCTRL->CTRLA.reg = NVMCTRL_CTRLA_CMDEX_KEY | NVMCTRL_CTRLA_CMD_PBC;
+        while (NVMCTRL->INTFLAG.bit.READY == 0);
+
+        // fill page buffer up to end of current page
+        do {
+            len = min(size, sizeof(word));
+            word = 0xFFFFFFFF;
+            memcpy(&word, src, len);
+            *dst++ = word;
+            src += len;
+            size -= len;
+        } while (size && ((uintptr_t)dst % NVM_PAGE_SIZE) != 0);
+
+        NVMCTRL->CTRLA.reg = NVMCTRL_CTRLA_CMDEX_KEY | NVMCTRL_CTRLA_CMD_WP;
+        while (NVMCTRL->INTFLAG.bit.READY == 0);
+    }
+}
+
+
+// erase flash row at given (row aligned) address
+void nvm_erase(const volatile void *addr) {
+    NVMCTRL->ADDR.reg = ((uintptr_t)addr) / 2;
+    NVMCTRL->CTRLA.reg = NVMCTRL_CTRLA_CMDEX_KEY | NVMCTRL_CTRLA_CMD_ER;
+    while (NVMCTRL->INTFLAG.bit.READY == 0);
+}
+
+
+// returns true if flash at given address is erased
+bool nvm_blank(const volatile void *addr, uint16_t size) {
+    const volatile uint8_t *src = (const volatile uint8_t *)addr;
+
+    while (size--) {
+        if (*src++ != 0xFF)
+            return false;
+    }
+    return true;
+}
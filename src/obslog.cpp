@@ -0,0 +1,164 @@
+/***************************************************************************
+  Copyright (c) 2024 Lars Wessels
+
+  This file is part of the "Feather-M0-LoRaWAN-PM-Sensor" source code.
+  https://github.com/lrswss/feather-m0-lorawan-pm-sensor
+
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+   
+  http://www.apache.org/licenses/LICENSE-2.0
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+***************************************************************************/
+
+#include "obslog.h"
+#include "payload.h"
+#include "nvm.h"
+#include "utils.h"
+
+#define LOG_MODULE LOG_LEVEL_STORAGE
+
+#define ROW_PAGES (NVM_ROW_SIZE / NVM_PAGE_SIZE)
+#define OBSLOG_PAGES (OBSLOG_ROWS * ROW_PAGES)
+#define OBSLOG_UNSENT 0xFFFFFFFF
+
+// one log record per flash page, 'sent' is the last word of the page and
+// remains erased (0xFFFFFFFF) until the observation has been transmitted
+typedef struct {
+    uint32_t magic;
+    uint32_t seqno;
+    uint32_t timestamp;
+    uint8_t len;
+    uint8_t data[PAYLOAD_MAX_SIZE - 1];
+    uint8_t crc; // covers all bytes before
+    uint8_t reserved[NVM_PAGE_SIZE - PAYLOAD_MAX_SIZE - 17];
+    uint32_t sent;
+} obslogRecord_t;
+
+NVM_AREA(obslogArea, OBSLOG_ROWS);
+
+static uint16_t headPage = 0;  // next page to be written
+static uint32_t nextSeqno = 1;
+static uint16_t unsent = 0;
+
+
+static const volatile uint8_t* obslog_addr(uint16_t page) {
+    return obslogArea + page * NVM_PAGE_SIZE;
+}
+
+
+// read record from given page, returns false if page holds no valid
+// record (erased, not yet written or write interrupted by power loss)
+static bool obslog_read(uint16_t page, obslogRecord_t *record) {
+    nvm_read(obslog_addr(page), record, sizeof(obslogRecord_t));
+    return record->magic == OBSLOG_MAGIC &&
+        record->crc == crc8((uint8_t *)record, offsetof(obslogRecord_t, crc));
+}
+
+
+static bool obslog_unsent(uint16_t page) {
+    obslogRecord_t record;
+    return obslog_read(page, &record) && record.sent == OBSLOG_UNSENT;
+}
+
+
+// find head of log (page after record with highest sequence number)
+// and count observations which have not been sent yet
+void obslog_init() {
+    obslogRecord_t record;
+
+    static_assert(sizeof(obslogRecord_t) == NVM_PAGE_SIZE, "obslogRecord_t must fill a flash page");
+    for (uint16_t page = 0; page < OBSLOG_PAGES; page++) {
+        if (!obslog_read(page, &record))
+            continue;
+        if (record.seqno >= nextSeqno) {
+            nextSeqno = record.seqno + 1;
+            headPage = (page + 1) % OBSLOG_PAGES;
+        }
+        if (record.sent == OBSLOG_UNSENT)
+            unsent++;
+    }
+    log_info("Observation log holds %d unsent observations (next record %ld)", unsent, nextSeqno);
+}
+
+
+// write observation with given timestamp to log
+// returns page number to mark it as sent later
+uint16_t obslog_append(sensorReadings_t *readings, uint32_t timestamp) {
+    obslogRecord_t record;
+    uint16_t page;
+
+    // don't write to page if previous write was interrupted
+    if ((headPage % ROW_PAGES) != 0 && !nvm_blank(obslog_addr(headPage), NVM_PAGE_SIZE))
+        headPage = ((headPage / ROW_PAGES + 1) * ROW_PAGES) % OBSLOG_PAGES;
+
+    // erase next row, oldest observations are lost
+    if ((headPage % ROW_PAGES) == 0) {
+        for (page = headPage; page < headPage + ROW_PAGES; page++) {
+            if (obslog_unsent(page)) {
+                log_warn("[WARNING] Observation log full, dropping unsent observation!");
+                unsent--;
+            }
+        }
+        nvm_erase(obslog_addr(headPage));
+    }
+
+    memset(&record, 0xFF, sizeof(record));
+    record.magic = OBSLOG_MAGIC;
+    record.seqno = nextSeqno++;
+    record.timestamp = timestamp;
+    record.len = payload_record(record.data, readings);
+    record.crc = crc8((uint8_t *)&record, offsetof(obslogRecord_t, crc));
+    nvm_write(obslog_addr(headPage), &record, offsetof(obslogRecord_t, sent));
+    unsent++;
+
+    page = headPage;
+    headPage = (headPage + 1) % OBSLOG_PAGES;
+    return page;
+}
+
+
+// mark observation on given page as sent (clears last word without erasing row)
+void obslog_sent(uint16_t page) {
+    uint32_t sent = 0;
+
+    if (!obslog_unsent(page))
+        return;
+    nvm_write(obslog_addr(page) + offsetof(obslogRecord_t, sent), &sent, sizeof(sent));
+    unsent--;
+}
+
+
+// returns number of observations not sent yet
+uint16_t obslog_pending() {
+    return unsent;
+}
+
+
+// fill backlog frame with oldest unsent observations which fit into maxlen bytes
+// returns length of frame, pages of observations added can be marked as sent later
+uint8_t obslog_backlog(uint8_t *buf, uint8_t maxlen, uint32_t now, uint16_t *pages, uint8_t maxpages, uint8_t *added) {
+    obslogRecord_t record;
+    uint16_t page;
+    uint8_t len = 1;
+
+    buf[0] = PAYLOAD_BATCH_VERSION;
+    *added = 0;
+    for (uint16_t i = 0; i < OBSLOG_PAGES && *added < maxpages; i++) {
+        page = (headPage + i) % OBSLOG_PAGES;
+        if (!obslog_read(page, &record) || record.sent != OBSLOG_UNSENT)
+            continue;
+        if (!payload_append(buf, &len, maxlen, record.data, record.len,
+                now > record.timestamp ? now - record.timestamp : 0))
+            break;
+        pages[(*added)++] = page;
+    }
+    return len;
+}
@@ -0,0 +1,303 @@
+/***************************************************************************
+  Copyright (c) 2024 Lars Wessels
+
+  This file is part of the "Feather-M0-LoRaWAN-PM-Sensor" source code.
+  https://github.com/lrswss/feather-m0-lorawan-pm-sensor
+
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+   
+  http://www.apache.org/licenses/LICENSE-2.0
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+***************************************************************************/
+
+#include "payload.h"
+#include "sensors.h"
+#include "utils.h"
+#include "settings.h"
+
+#define LOG_MODULE LOG_LEVEL_STORAGE
+
+typedef struct {
+    uint32_t timestamp;
+    uint16_t tag;
+    uint8_t len;
+    uint8_t data[PAYLOAD_MAX_SIZE - 1];
+} payloadRecord_t;
+
+// ring buffer with encoded observations for batch frames
+static payloadRecord_t records[PAYLOAD_BUFFER_SIZE];
+static uint8_t recordsHead = 0;
+static uint8_t recordsCount = 0;
+
+
+// version 2: fixed TLV format, one tag byte per field
+static uint8_t payload_v2(uint8_t *payload, sensorReadings_t *readings) {
+    uint8_t i = 1;
+    uint16_t payloadValInt;
+
+    payload[0] = 2; // 1
+
+    // sensor sensors status
+    payload[i++] = readings->status; // 2
+
+#ifdef VBAT_PIN
+    if (readings->vbat > VBAT_MIN_MV) {
+        payload[i++] = 0x01;  // V
+        payload[i++] = byte(readings->vbat / 10 - 256);
+    } // 4
+#endif
+    if ((readings->status & SENSORS_I2C_FAILED) == 0) {
+        payloadValInt = readings->temperature;
+        payload[i++] = 0x10; // degree celcius
+        payload[i++] = (payloadValInt >> 8) & 0xff;
+        payload[i++] = payloadValInt & 0xff;
+        payload[i++] = 0x11; // %
+        payload[i++] = readings->humidity;
+    } // 9
+
+    if (readings->status & SENSORS_HAS_BME280) {
+        payloadValInt = readings->pressure;
+        payload[i++] = 0x12; // hPa
+        payload[i++] = (payloadValInt >> 8) & 0xff;
+        payload[i++] = payloadValInt & 0xff;
+    } // 12
+
+    if ((readings->status & SENSORS_SDS011_ERROR) == 0 && readings->pm25 >= 0) {
+        payloadValInt = readings->pm25;
+        payload[i++] = 0x50; // μg/m3
+        payload[i++] = (payloadValInt >> 8) & 0xff;
+        payload[i++] = payloadValInt & 0xff;
+        payloadValInt = readings->pm10;
+        payload[i++] = 0x51; // μg/m3
+        payload[i++] = (payloadValInt >> 8) & 0xff;
+        payload[i++] = payloadValInt & 0xff;
+    } // 18
+
+    return i;
+}
+
+
+// append given number of bits (MSB first) to bit stream
+static void put_bits(uint8_t *buf, uint16_t *pos, uint16_t value, uint8_t bits) {
+    while (bits-- > 0) {
+        if (value & (1 << bits))
+            buf[*pos / 8] |= 0x80 >> (*pos % 8);
+        (*pos)++;
+    }
+}
+
+
+// limit value to range [0, 2^bits - 2], all bits set marks an invalid value
+static uint16_t clamp_bits(int32_t value, uint8_t bits) {
+    return constrain(value, 0, (1 << bits) - 2);
+}
+
+
+// integer division rounding half away from zero
+static int32_t div_round(int32_t value, int32_t divisor) {
+    return (value + (value < 0 ? -divisor : divisor) / 2) / divisor;
+}
+
+
+// PM values with 0.1 μg/m3 resolution below 50 μg/m3 and 2 μg/m3 above
+static uint16_t pm_code(int16_t pm) {
+    if (pm < 500)
+        return clamp_bits(pm, PAYLOAD_V3_PM_BITS);
+    return min(500 + (pm - 490) / 20, (1 << PAYLOAD_V3_PM_BITS) - 1);
+}
+
+
+// extension flags for version 4, optional fields
+// can be turned off remotely (see settings.h)
+static uint8_t payload_ext(sensorReadings_t *readings) {
+    uint8_t ext = 0;
+
+    if (readings->interval > 0)
+        ext |= PAYLOAD_EXT_INTERVAL;
+    if ((readings->status & SENSORS_SDS011_ERROR) == 0 && readings->pm25 < 0)
+        ext |= PAYLOAD_EXT_NO_PM;
+    if (readings->power != BATTERY_NORMAL)
+        ext |= PAYLOAD_EXT_BATTERY;
+#ifdef PAYLOAD_PM_STATS
+    if ((readings->status & SENSORS_SDS011_ERROR) == 0 && readings->pm25 >= 0 && readings->pmSamples > 0)
+        ext |= PAYLOAD_EXT_STATS;
+#endif
+    if (readings->alert != 0)
+        ext |= PAYLOAD_EXT_ALERT;
+    ext &= settings.fields | ~SETTINGS_FIELDS;
+    if (readings->settingsAck >= 0)
+        ext |= PAYLOAD_EXT_SETTINGS;
+    return ext;
+}
+
+
+// version 3/4: bit-packed fields without tags, presence of
+// fields derived from sensor status (see payload.h)
+static uint8_t payload_packed(uint8_t *payload, uint8_t version, sensorReadings_t *readings) {
+    uint8_t i = 0, ext = 0;
+    uint16_t pos;
+
+    memset(payload, 0, PAYLOAD_MAX_SIZE);
+    payload[i++] = version;
+    payload[i++] = readings->status;
+    if (version >= 4) {
+        ext = payload_ext(readings);
+        payload[i++] = ext;
+    } else if (readings->pm25 < 0) {
+        payload[i-1] |= SENSORS_SDS011_ERROR; // no PM values
+    }
+#ifdef VBAT_PIN
+    if (readings->vbat > VBAT_MIN_MV)
+        payload[i] = byte(readings->vbat / 10 - 256);
+#endif
+    pos = ++i * 8;
+
+    if (readings->status & (SENSORS_HAS_BME280|SENSORS_HAS_SHT31|SENSORS_HAS_SI7021)) {
+        if (readings->temperature > SENSORS_TEMP_INVALID)
+            put_bits(payload, &pos, clamp_bits(div_round(readings->temperature, 10) + 400,
+                PAYLOAD_V3_TEMP_BITS), PAYLOAD_V3_TEMP_BITS);
+        else
+            put_bits(payload, &pos, 0xFFFF, PAYLOAD_V3_TEMP_BITS);
+        if (readings->humidity >= 0)
+            put_bits(payload, &pos, clamp_bits(readings->humidity, PAYLOAD_V3_HUM_BITS),
+                PAYLOAD_V3_HUM_BITS);
+        else
+            put_bits(payload, &pos, 0xFFFF, PAYLOAD_V3_HUM_BITS);
+    }
+
+    if (readings->status & SENSORS_HAS_BME280)
+        put_bits(payload, &pos, clamp_bits(div_round(readings->pressure - 5000, 2),
+            PAYLOAD_V3_PRES_BITS), PAYLOAD_V3_PRES_BITS);
+
+    if ((payload[1] & SENSORS_SDS011_ERROR) == 0 && (ext & PAYLOAD_EXT_NO_PM) == 0) {
+        put_bits(payload, &pos, pm_code(readings->pm25), PAYLOAD_V3_PM_BITS);
+        put_bits(payload, &pos, pm_code(readings->pm10), PAYLOAD_V3_PM_BITS);
+    }
+
+    if (ext & PAYLOAD_EXT_INTERVAL)
+        put_bits(payload, &pos, constrain(readings->interval / 60, 1, 255), 8);
+    if (ext & PAYLOAD_EXT_BATTERY) {
+        put_bits(payload, &pos, min(readings->soc, 100), 7);
+        put_bits(payload, &pos, readings->power, 2);
+    }
+    if (ext & PAYLOAD_EXT_STATS) {
+        put_bits(payload, &pos, readings->pmSamples, 8);
+        put_bits(payload, &pos, pm_code(readings->pm25Stats.min), PAYLOAD_V3_PM_BITS);
+        put_bits(payload, &pos, pm_code(readings->pm25Stats.max), PAYLOAD_V3_PM_BITS);
+        put_bits(payload, &pos, pm_code(min(readings->pm25Stats.stddev, 0x7FFF)), PAYLOAD_V3_PM_BITS);
+        put_bits(payload, &pos, pm_code(readings->pm10Stats.min), PAYLOAD_V3_PM_BITS);
+        put_bits(payload, &pos, pm_code(readings->pm10Stats.max), PAYLOAD_V3_PM_BITS);
+        put_bits(payload, &pos, pm_code(min(readings->pm10Stats.stddev, 0x7FFF)), PAYLOAD_V3_PM_BITS);
+    }
+    if (ext & PAYLOAD_EXT_ALERT)
+        put_bits(payload, &pos, readings->alert, 3);
+    if (ext & PAYLOAD_EXT_SETTINGS)
+        put_bits(payload, &pos, readings->settingsAck, 8);
+
+    return (pos + 7) / 8;
+}
+
+
+// encode sensor readings with given payload version into buf
+// (at least PAYLOAD_MAX_SIZE bytes), returns length of payload
+uint8_t payload_encode(uint8_t *buf, uint8_t version, sensorReadings_t *readings) {
+    if (version == 2)
+        return payload_v2(buf, readings);
+    return payload_packed(buf, version, readings);
+}
+
+
+// encode observation with PAYLOAD_BATCH_VERSION without version byte
+// buf requires at least PAYLOAD_MAX_SIZE bytes, returns length
+uint8_t payload_record(uint8_t *buf, sensorReadings_t *readings) {
+    uint8_t len = payload_packed(buf, PAYLOAD_BATCH_VERSION, readings) - 1;
+
+    memmove(buf, buf + 1, len);
+    return len;
+}
+
+
+// append observation (see payload_record()) with its age in seconds
+// (LEB128 varint) to batch frame; returns false if it doesn't fit
+bool payload_append(uint8_t *buf, uint8_t *len, uint8_t maxlen,
+        const uint8_t *record, uint8_t recordLen, uint32_t age) {
+    uint8_t ageLen = 0, ageBuf[5];
+
+    for (; age >= 0x80; age >>= 7)
+        ageBuf[ageLen++] = (age & 0x7F) | 0x80;
+    ageBuf[ageLen++] = age;
+    if (*len + ageLen + recordLen > maxlen)
+        return false;
+    memcpy(buf + *len, ageBuf, ageLen);
+    memcpy(buf + *len + ageLen, record, recordLen);
+    *len += ageLen + recordLen;
+    return true;
+}
+
+
+// encode observation and add it to ring buffer for batch frames, tag can be
+// used by caller to identify it later; overwrites oldest if buffer is full
+void payload_push(sensorReadings_t *readings, uint32_t timestamp, uint16_t tag) {
+    uint8_t buf[PAYLOAD_MAX_SIZE];
+    payloadRecord_t *record = &records[recordsHead];
+
+    if (recordsCount == PAYLOAD_BUFFER_SIZE)
+        log_warn("[WARNING] Observation buffer full, dropping oldest observation!");
+    else
+        recordsCount++;
+    record->len = payload_record(buf, readings);
+    memcpy(record->data, buf, record->len);
+    record->timestamp = timestamp;
+    record->tag = tag;
+    recordsHead = (recordsHead + 1) % PAYLOAD_BUFFER_SIZE;
+}
+
+
+// returns number of buffered observations
+uint8_t payload_pending() {
+    return recordsCount;
+}
+
+
+// returns buffered observation with given index (0 is oldest)
+static payloadRecord_t* payload_buffered(uint8_t i) {
+    return &records[(recordsHead + PAYLOAD_BUFFER_SIZE - recordsCount + i) % PAYLOAD_BUFFER_SIZE];
+}
+
+
+// returns tag of buffered observation with given index (0 is oldest)
+uint16_t payload_tag(uint8_t i) {
+    return payload_buffered(i)->tag;
+}
+
+
+// fill batch frame with as many buffered observations (oldest first) as fit
+// into maxlen bytes; returns length of frame and number of observations added
+// (observations remain buffered until payload_drop() is called)
+uint8_t payload_batch(uint8_t *buf, uint8_t maxlen, uint32_t now, uint8_t *added) {
+    uint8_t len = 1;
+    payloadRecord_t *record;
+
+    buf[0] = PAYLOAD_BATCH_VERSION;
+    for (*added = 0; *added < recordsCount; (*added)++) {
+        record = payload_buffered(*added);
+        if (!payload_append(buf, &len, maxlen, record->data, record->len,
+                now > record->timestamp ? now - record->timestamp : 0))
+            break;
+    }
+    return len;
+}
+
+
+// remove given number of oldest observations from buffer
+void payload_drop(uint8_t dropped) {
+    recordsCount -= min(dropped, recordsCount);
+}
@@ -0,0 +1,93 @@
+/***************************************************************************
+  Copyright (c) 2024 Lars Wessels
+
+  This file is part of the "Feather-M0-LoRaWAN-PM-Sensor" source code.
+  https://github.com/lrswss/feather-m0-lorawan-pm-sensor
+
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+   
+  http://www.apache.org/licenses/LICENSE-2.0
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+***************************************************************************/
+
+#include "profile.h"
+#include "utils.h"
+
+#define LOG_MODULE LOG_LEVEL_SYSTEM
+
+#ifdef PROFILING
+typedef struct {
+    uint32_t count;
+    uint32_t min;
+    uint32_t max;
+    uint64_t sum;
+} profileEntry_t;
+
+static const char *const sectionNames[PROFILE_SECTIONS] = {
+    "SDS011::cmd", "SDS011::read", "SDS011::poll", "I2C read",
+    "lmic_txdata", "log_msg", "onEvent"
+};
+
+static profileEntry_t entries[PROFILE_SECTIONS];
+
+
+// core clock cycles since startup (wraps after ~89 secs at 48 MHz), SysTick
+// counts down from LOAD to 0 every millisecond; if it has just wrapped
+// and its interrupt is still pending millis() is one behind
+static uint32_t profile_cycles() {
+    uint32_t ms, ticks;
+
+    noInterrupts();
+    ms = millis();
+    ticks = SysTick->VAL;
+    if (SCB->ICSR & SCB_ICSR_PENDSTSET_Msk) {
+        ticks = SysTick->VAL;
+        ms++;
+    }
+    interrupts();
+    return ms * (SysTick->LOAD + 1) + (SysTick->LOAD - ticks);
+}
+
+
+ProfileScope::ProfileScope(profileSection_t section) {
+    this->section = section;
+    start = profile_cycles();
+}
+
+
+ProfileScope::~ProfileScope() {
+    uint32_t cycles = profile_cycles() - start;
+    profileEntry_t *entry = &entries[section];
+
+    if (entry->count == 0 || cycles < entry->min)
+        entry->min = cycles;
+    if (cycles > entry->max)
+        entry->max = cycles;
+    entry->sum += cycles;
+    entry->count++;
+}
+
+
+// print number of calls and min/mean/max cycles of each section measured
+// since startup (copy of table, log messages are measured as well)
+void profile_dump() {
+    profileEntry_t table[PROFILE_SECTIONS];
+
+    memcpy(table, entries, sizeof(table));
+    log_info("Profile (cycles at %ld MHz): section, calls, min, mean, max", F_CPU / 1000000);
+    for (uint8_t i = 0; i < PROFILE_SECTIONS; i++) {
+        if (table[i].count == 0)
+            continue;
+        log_info("%s, %ld, %ld, %ld, %ld", sectionNames[i], table[i].count, table[i].min,
+            (uint32_t)(table[i].sum / table[i].count), table[i].max);
+    }
+}
+#endif
@@ -21,20 +21,227 @@
 #include "rtc.h"
 #include "utils.h"
 #include "lorawan.h"
+#include "nvm.h"
+
+#define LOG_MODULE LOG_LEVEL_SYSTEM
 
 RTCZero rtc;
 
 
+// halt CPU until next interrupt (e.g. SysTick, UART); unlike standby
+// all clocks keep running, so millis() and LMIC's clock are not stopped
+void idle() {
+    SCB->SCR &= ~SCB_SCR_SLEEPDEEP_Msk;
+    PM->SLEEP.reg = PM_SLEEP_IDLE_CPU;
+    __DSB();
+    __WFI();
+}
+
+
+// time spent in standby (ms), millis() is stopped in standby
+static uint32_t standbyMillis = 0;
+
+
+// enter standby for given number of seconds (wake up by RTC alarm),
+// returns number of seconds actually spent in standby; the RTC has no
+// subseconds and its alarm fires at a second edge, so the first (partial)
+// second is spent in idle mode until the RTC's next second (see millis())
+uint16_t standby(uint16_t secs) {
+    uint32_t start = rtc.getEpoch();
+    uint32_t waitMillis = millis();
+#if defined(LOG_DMA) && defined(SERIAL_BAUD)
+    uint32_t dropped = serial.overflows();
+
+    if (dropped > 0)
+        log_warn("[WARNING] Log buffer overflow, %ld bytes dropped", dropped);
+#endif
+
+    serial.flush(); // drain log output before standby
+    while (rtc.getEpoch() == start && millis() - waitMillis < 1100)
+        idle();
+    start = rtc.getEpoch();
+    if (secs <= 1)
+        return 0;
+
+    rtc.setAlarmEpoch(start + secs - 1);
+    rtc.enableAlarm(rtc.MATCH_HHMMSS);
+    rtc.standbyMode();
+
+    secs = rtc.getEpoch() - start;
+    standbyMillis += secs * 1000UL;
+    return secs;
+}
+
+
 // put MCU to sleep for given number of seconds
 // by setting an alarm using its RTC
 void sleep(uint16_t secs) {
-    rtc.setAlarmEpoch(rtc.getEpoch() + secs);
-    log_msg("Sleeping for %d seconds, wake up at %02d:%02d:%02d (UTC)...", 
+    rtc.setAlarmEpoch(rtc.getEpoch() + secs); // for log message only
+    log_info("Sleeping for %d seconds, wake up at %02d:%02d:%02d (UTC)...", 
         secs, rtc.getAlarmHours(), rtc.getAlarmMinutes(), rtc.getAlarmSeconds());
-    rtc.enableAlarm(rtc.MATCH_HHMMSS);
-    Serial1.flush();
-    rtc.standbyMode();
+    standby(secs);
 
     blink_led(250, 2);
-    log_msg("Waking up...");
-}
\ No newline at end of file
+    log_info("Waking up...");
+}
+
+
+// milliseconds since startup including time spent in standby
+uint32_t uptime_ms() {
+    return millis() + standbyMillis;
+}
+
+#ifdef RTC_CALIBRATION
+typedef struct {
+    uint32_t magic;
+    int8_t freqCorr;
+    uint8_t crc; // covers all bytes before
+} rtcCalibration_t;
+
+NVM_AREA(calibrationArea, 1);
+
+static int8_t freqCorr = 0; // steps of RTC_FREQCORR_PPB, positive speeds up RTC
+static uint32_t syncEpoch = 0; // start of drift measurement (RTC)
+static int32_t syncOffset = 0; // offset (ms) of RTC at syncEpoch
+static int32_t syncDrift = 0; // residual drift (ppb) after frequency correction
+static bool syncMeasured = false; // syncDrift has been measured since startup
+static uint32_t syncNext = 0; // request network time after this epoch
+
+// network time received and pending RTC update (see rtc_sync_job())
+static osjob_t syncJob;
+static uint32_t syncTimeEpoch, syncTimeMs, syncTimeMillis, syncTimeRtc;
+
+
+// integer division rounding half away from zero
+static int32_t div_round(int32_t value, int32_t divisor) {
+    return (value + (value < 0 ? -divisor : divisor) / 2) / divisor;
+}
+
+
+// set frequency correction of RTC (positive value speeds up RTC)
+static void rtc_freqcorr(int8_t value) {
+    RTC->MODE2.FREQCORR.reg = (value > 0 ? RTC_FREQCORR_SIGN : 0) | RTC_FREQCORR_VALUE(abs(value));
+    while (RTC->MODE2.STATUS.bit.SYNCBUSY);
+}
+
+
+// restore frequency correction of RTC saved in flash
+void rtc_sync_init() {
+    rtcCalibration_t calibration;
+
+    nvm_read(calibrationArea, &calibration, sizeof(calibration));
+    if (calibration.magic != RTC_CALIBRATION_MAGIC ||
+            calibration.crc != crc8((uint8_t *)&calibration, offsetof(rtcCalibration_t, crc)))
+        return;
+    freqCorr = constrain(calibration.freqCorr, -RTC_FREQCORR_MAX, RTC_FREQCORR_MAX);
+    rtc_freqcorr(freqCorr);
+    log_info("Restored RTC frequency correction (%d ppb)", freqCorr * RTC_FREQCORR_PPB);
+}
+
+
+static void rtc_sync_save() {
+    rtcCalibration_t calibration;
+
+    memset(&calibration, 0, sizeof(calibration));
+    calibration.magic = RTC_CALIBRATION_MAGIC;
+    calibration.freqCorr = freqCorr;
+    calibration.crc = crc8((uint8_t *)&calibration, offsetof(rtcCalibration_t, crc));
+    nvm_erase(calibrationArea);
+    nvm_write(calibrationArea, &calibration, sizeof(calibration));
+}
+
+
+// seconds until offset of RTC reaches RTC_SYNC_TOLERANCE_MS at
+// residual drift, within RTC_SYNC_MIN_SECS and RTC_SYNC_MAX_SECS
+static uint32_t rtc_sync_interval(int32_t offset) {
+    int32_t left = RTC_SYNC_TOLERANCE_MS - (syncDrift > 0 ? offset : -offset);
+    uint64_t secs;
+
+    if (!syncMeasured || left <= 0)
+        return RTC_SYNC_MIN_SECS;
+    if (syncDrift == 0)
+        return RTC_SYNC_MAX_SECS;
+    secs = (uint64_t)left * 1000000ULL / abs(syncDrift); // ppb: 1 ms in 10^6 secs
+    return constrain(secs, RTC_SYNC_MIN_SECS, RTC_SYNC_MAX_SECS);
+}
+
+
+// compare RTC with network time (UTC, secs and ms) at its next second,
+// adjust frequency correction of RTC by drift measured since last adjustment,
+// set RTC if off by RTC_SYNC_TOLERANCE_MS and schedule next network time
+// request (see rtc.h)
+static void rtc_sync_update(uint32_t epoch, uint32_t ms) {
+    uint32_t now = rtc.getEpoch(), elapsed;
+    int32_t offset, drift, steps;
+
+    if (syncEpoch == 0 || abs((int32_t)(epoch - now)) >= 86400) { // not set since startup
+        rtc.setEpoch(epoch + (ms + 500) / 1000);
+        syncEpoch = rtc.getEpoch();
+        syncOffset = ms - (ms + 500) / 1000 * 1000;
+        syncNext = syncEpoch + RTC_SYNC_MIN_SECS;
+        log_info("Set RTC to LoRaWAN network time");
+        return;
+    }
+
+    offset = (int32_t)(epoch - now) * 1000 + ms; // > 0 if RTC is slow
+    elapsed = now - syncEpoch;
+    if (elapsed >= RTC_SYNC_MIN_SECS) {
+        // only full steps, remaining drift is measured over a longer time
+        drift = (int64_t)(offset - syncOffset) * 1000000LL / elapsed; // ppb
+        steps = constrain(freqCorr + drift / RTC_FREQCORR_PPB, -RTC_FREQCORR_MAX, RTC_FREQCORR_MAX);
+        log_info("RTC drift %d ppb (%d ms in %ld secs), frequency correction %d ppb",
+            drift, offset - syncOffset, elapsed, steps * RTC_FREQCORR_PPB);
+        syncDrift = drift - (steps - freqCorr) * RTC_FREQCORR_PPB;
+        syncMeasured = true;
+        if (steps != freqCorr) {
+            freqCorr = steps;
+            rtc_freqcorr(freqCorr);
+            rtc_sync_save();
+            syncEpoch = now; // restart drift measurement
+            syncOffset = offset;
+        }
+    }
+
+    if (abs(offset) >= RTC_SYNC_TOLERANCE_MS) {
+        rtc.setEpoch(now + div_round(offset, 1000));
+        log_info("Set RTC to LoRaWAN network time (off by %d ms)", offset);
+        offset -= div_round(offset, 1000) * 1000;
+        syncEpoch = rtc.getEpoch();
+        syncOffset = offset;
+    }
+
+    now = rtc.getEpoch();
+    syncNext = now + rtc_sync_interval(offset);
+    log_info("RTC off by %d ms, next network time request in %ld secs", offset, syncNext - now);
+}
+
+
+// RTC has no subseconds, so wait for its next second to measure offset in ms;
+// polls RTC every ms as LMIC job, which keeps MCU in idle mode (see scheduler.h)
+static void rtc_sync_job(osjob_t *j) {
+    uint32_t elapsed = millis() - syncTimeMillis;
+
+    if (rtc.getEpoch() == syncTimeRtc && elapsed < 1100) {
+        os_setTimedCallback(j, os_getTime() + ms2osticks(1), rtc_sync_job);
+        return;
+    }
+    rtc_sync_update(syncTimeEpoch + (syncTimeMs + elapsed) / 1000, (syncTimeMs + elapsed) % 1000);
+}
+
+
+// sync RTC with given network time (UTC, secs and ms), the RTC is
+// updated by a separate LMIC job at its next second (rtc_sync_job())
+void rtc_sync(uint32_t epoch, uint32_t ms) {
+    syncTimeEpoch = epoch;
+    syncTimeMs = ms;
+    syncTimeMillis = millis();
+    syncTimeRtc = rtc.getEpoch();
+    os_setCallback(&syncJob, rtc_sync_job);
+}
+
+
+// returns true if network time should be requested with next uplink
+bool rtc_sync_due() {
+    return syncNext == 0 || rtc.getEpoch() >= syncNext;
+}
+#endif
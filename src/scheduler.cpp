@@ -0,0 +1,117 @@
+/***************************************************************************
+  Copyright (c) 2024 Lars Wessels
+
+  This file is part of the "Feather-M0-LoRaWAN-PM-Sensor" source code.
+  https://github.com/lrswss/feather-m0-lorawan-pm-sensor
+
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+   
+  http://www.apache.org/licenses/LICENSE-2.0
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+***************************************************************************/
+
+#include "scheduler.h"
+#include "lorawan.h"
+#include "rtc.h"
+#include "utils.h"
+
+#define LOG_MODULE LOG_LEVEL_SYSTEM
+
+static schedulerTask_t *tasks[SCHEDULER_MAX_TASKS];
+static uint8_t tasksCount = 0;
+
+
+// milliseconds until given task is due (0 if overdue)
+static uint32_t scheduler_left(schedulerTask_t *task, uint32_t now) {
+    return (int32_t)(task->due - now) > 0 ? task->due - now : 0;
+}
+
+
+// (re)schedule LMIC job of given task for its due time
+static void scheduler_arm(schedulerTask_t *task, uint32_t now) {
+    os_setTimedCallback(&task->job, os_getTime() + ms2osticks(scheduler_left(task, now)), task->func);
+}
+
+
+// schedule task to run given function at given time (uptime_ms()),
+// replaces previous schedule of this task
+void scheduler_at(schedulerTask_t *task, osjobcb_t func, uint32_t due) {
+    uint8_t i;
+
+    for (i = 0; i < tasksCount && tasks[i] != task; i++);
+    if (i == tasksCount) {
+        if (tasksCount == SCHEDULER_MAX_TASKS) {
+            log_error("[ERROR] Too many scheduler tasks!");
+            return;
+        }
+        tasks[tasksCount++] = task;
+    }
+
+    os_clearCallback(&task->job);
+    task->func = func;
+    task->due = due;
+    task->timed = true;
+    scheduler_arm(task, uptime_ms());
+}
+
+
+// schedule task to run given function in given number of milliseconds
+void scheduler_in(schedulerTask_t *task, osjobcb_t func, uint32_t ms) {
+    scheduler_at(task, func, uptime_ms() + ms);
+}
+
+
+// returns milliseconds until next task is due, 0 if none is scheduled
+// (tasks which have already been run are marked as not timed)
+static uint32_t scheduler_next(uint32_t now) {
+    uint32_t next = 0, left;
+
+    for (uint8_t i = 0; i < tasksCount; i++) {
+        if (!tasks[i]->timed)
+            continue;
+        if (!os_jobIsTimed(&tasks[i]->job)) {
+            tasks[i]->timed = false;
+            continue;
+        }
+        left = scheduler_left(tasks[i], now);
+        if (next == 0 || left < next)
+            next = max(left, 1UL);
+    }
+    return next;
+}
+
+
+// run due LMIC jobs (and tasks), then put MCU to standby until next task
+// is due if LMIC is idle meanwhile, otherwise to idle mode until next
+// interrupt; since LMIC's clock stops in standby all tasks are rescheduled
+// and LMIC's duty cycle limits are shifted by the time spent in standby
+void scheduler_run() {
+    uint32_t now, next;
+    uint16_t secs;
+
+    os_runloop_once();
+    now = uptime_ms();
+    next = scheduler_next(now);
+    secs = min(next / 1000, 0xFFFFUL);
+    if (secs < SCHEDULER_STANDBY_SECS || !lmic_idle(secs)) {
+        idle();
+        return;
+    }
+
+    log_debug("Standby for %d secs until next task is due", secs);
+    standby(secs);
+    lmic_standby(uptime_ms() - now);
+    now = uptime_ms();
+    for (uint8_t i = 0; i < tasksCount; i++) {
+        if (tasks[i]->timed)
+            scheduler_arm(tasks[i], now);
+    }
+}
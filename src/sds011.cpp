@@ -21,6 +21,11 @@
 #include "sds011.h"
 #include "utils.h"
 #include "pins.h"
+#include "rtc.h"
+#include "diag.h"
+#include "profile.h"
+
+#define LOG_MODULE LOG_LEVEL_SENSORS
 
 // stubs for relevant SDS011 serial commands
 static const uint8_t CMD_SLEEP[5] = { 0xAA, 0xB4, 0x06, 0x01, 0x00 };
@@ -29,6 +34,12 @@ static const uint8_t CMD_PASSIVE[5] = { 0xAA, 0xB4, 0x02, 0x01, 0x01 };
 static const uint8_t CMD_QUERY[5] = { 0xAA, 0xB4, 0x04, 0x00, 0x00 };
 static const uint8_t CMD_VERSION[5] = { 0xAA, 0xB4, 0x07, 0x00, 0x00 };
 
+// ring buffer for complete (CRC checked) response frames, filled by
+// the frame parser which runs in the SERCOM1 interrupt handler
+static volatile uint8_t rxFrames[RX_FRAMES][SDS011_FRAME_LEN];
+static volatile uint8_t rxHead = 0;
+static volatile uint8_t rxTail = 0;
+
 
 // SERCOM muxing on M0 for additional UART, SPI, I2C ports
 // SERCOM1 can be assigned on Feather M0 LoRa (D10-D13) not used
@@ -47,13 +58,56 @@ static const uint8_t CMD_VERSION[5] = { 0xAA, 0xB4, 0x07, 0x00, 0x00 };
 Uart Serial2 (&sercom1, SDS011_TX_PIN, SDS011_RX_PIN, SERCOM_RX_PAD_0, UART_TX_PAD_2);
 
 
+// frames returned by the parser are only valid until the next byte
+// is received, so copy them to ring buffer (drop frame if buffer is full)
+static void sds011_rx(uint8_t c) {
+    static SDS011Parser parser;
+    const SDS011Frame *frame = parser.feed(c);
+
+    if (frame == NULL || ((rxHead + 1) % RX_FRAMES) == rxTail)
+        return;
+    memcpy((void *)rxFrames[rxHead], frame, SDS011_FRAME_LEN);
+    rxHead = (rxHead + 1) % RX_FRAMES;
+}
+
+
+// bytes received from SDS011 are passed to frame parser directly,
+// Uart::IrqHandler() still takes care of transmitting and UART errors
 void SERCOM1_Handler() {
+    if (sercom1.availableDataUART() && !sercom1.isFrameErrorUART())
+        sds011_rx(sercom1.readDataUART());
     Serial2.IrqHandler();
 }
 
 
 SDS011::SDS011(uint8_t secs) {
     warmupSecs = secs;
+    avgReadings = AVG_READINGS;
+    avgReadingsMs = AVG_READINGS_MS;
+    usedSamples = 0;
+    usedSecs = 0;
+    this->restart();
+}
+
+
+// change max. warmup time (secs), number of readings averaged and
+// pause between them (ms), e.g. after remote settings were changed
+void SDS011::configure(uint8_t secs, uint8_t readings, uint16_t readingsMs) {
+    warmupSecs = secs;
+    avgReadings = readings;
+    avgReadingsMs = readingsMs;
+}
+
+
+// reset warmup state, called on wakeup and sleep
+void SDS011::restart() {
+    startTime = 0;
+    stats_reset(&pm25Stats);
+    stats_reset(&pm10Stats);
+#ifdef SDS_ADAPTIVE_WARMUP
+    converged = false;
+    lastSample = 0;
+#endif
 }
 
 
@@ -65,38 +119,73 @@ void SDS011::begin() {
     pinPeripheral(11, PIO_SERCOM);
     this->wakeup();
     this->passiveMode();
-    startTime = millis();
+    startTime = uptime_ms();
 }
 
 
-// returns PM readings; sends query command to SDS011 and reads response
+// returns PM readings (μg/m3 * 10); sends query command to SDS011 and reads response
 // return false if warmup time (fan running) has not been reached
 // if parameter 'repeat' (max. 5) is set, average results after given number
 // of consecutive readings; prolongs poll time (DELAY_AVG_READINGS_MS * repeat)
-bool SDS011::poll(float *pm25, float *pm10, uint8_t repeat) {
+// with adaptive warmup the average of converged readings is returned instead;
+// readings are averaged with trimmed mean (see stats.h)
+bool SDS011::poll(int16_t *pm25, int16_t *pm10, uint8_t repeat) {
+    PROFILE(PROFILE_SDS011_POLL);
     if (!this->ready())
         return false;
 
-    *pm25 = 0; *pm10 = 0; repeat++;
+#ifdef SDS_ADAPTIVE_WARMUP
+    if (converged) {
+        *pm25 = stats_trimmed(&pm25Stats);
+        *pm10 = stats_trimmed(&pm10Stats);
+        usedSamples = pm25Stats.count;
+        usedSecs = (uptime_ms() - startTime) / 1000;
+        return true;
+    }
+#endif
+
+    stats_reset(&pm25Stats);
+    stats_reset(&pm10Stats);
+    repeat++;
     for (uint8_t i = 1; i < repeat; i++) {
         this->cmd(CMD_QUERY, "poll");
         if (this->read(0xC0)) {
-            *pm25 += (rxbuf[3] << 8 | rxbuf[2]) / 10.0;
-            *pm10 += (rxbuf[5] << 8 | rxbuf[4]) / 10.0;
+            stats_add(&pm25Stats, rxbuf[3] << 8 | rxbuf[2]);
+            stats_add(&pm10Stats, rxbuf[5] << 8 | rxbuf[4]);
             if (i == repeat-1) {
-                *pm25 /= i;
-                *pm10 /= i;
+                *pm25 = stats_trimmed(&pm25Stats);
+                *pm10 = stats_trimmed(&pm10Stats);
+                usedSamples = i;
+                usedSecs = (uptime_ms() - startTime) / 1000;
                 return true;
             }
         } else {
             return false;
         }
-        delay(AVG_READINGS_MS);
+        delay(avgReadingsMs);
     }
     return false;
 }
 
 
+// statistics (min, max, standard deviation) of readings used for last poll()
+void SDS011::pollStats(statsSummary_t *pm25, statsSummary_t *pm10) {
+    stats_summary(&pm25Stats, pm25);
+    stats_summary(&pm10Stats, pm10);
+}
+
+
+// number of readings and fan runtime in seconds used for last poll()
+uint8_t SDS011::pollSamples() {
+    return usedSamples;
+}
+
+
+uint16_t SDS011::pollSecs() {
+    return usedSecs;
+}
+
+
 // return firmware version and device id
 bool SDS011::info(char *version, uint16_t& id) {
     for (uint8_t i = 0; i < CMD_RETRY; i++) {
@@ -106,6 +195,7 @@ bool SDS011::info(char *version, uint16_t& id) {
             id = (static_cast<uint16_t>(rxbuf[6]) << 8) + rxbuf[7];
             return true;
         }
+        diag_add(DIAG_SDS011_RETRIES, 1);
         delay(CMD_RETRY_MS);
     }
     return false;
@@ -115,11 +205,14 @@ bool SDS011::info(char *version, uint16_t& id) {
 // send SDS011 to sleep (turns of fan and laser diode)
 // power consumption < 4mA
 bool SDS011::sleep() {
-    startTime = 0;
+    if (startTime > 0)
+        diag_add(DIAG_FAN_MS, uptime_ms() - startTime);
+    this->restart();
     for (uint8_t i = 0; i < CMD_RETRY; i++) {
         this->cmd(CMD_SLEEP, "sleep");
         if (this->read(0xC5, 0x06))
             return true;
+        diag_add(DIAG_SDS011_RETRIES, 1);
         delay(CMD_RETRY_MS);
     }
     return false;
@@ -128,11 +221,13 @@ bool SDS011::sleep() {
 
 // wake up SDS011 (fan spins up, laser diode on)
 bool SDS011::wakeup() {
-    startTime = millis();
+    this->restart();
+    startTime = uptime_ms();
     for (uint8_t i = 0; i < CMD_RETRY; i++) {
         this->cmd(CMD_WAKEUP, "wakeup");
         if (this->read(0xC5, 0x06))
             return true;
+        diag_add(DIAG_SDS011_RETRIES, 1);
         delay(CMD_RETRY_MS);
     }
     return false;
@@ -146,63 +241,112 @@ bool SDS011::passiveMode() {
         this->cmd(CMD_PASSIVE, "passiveMode");
         if (this->read(0xC5, 0x02))
             return true;
+        diag_add(DIAG_SDS011_RETRIES, 1);
         delay(CMD_RETRY_MS);
     }
     return false;
 }
 
 
-// read response on serial port after sending SDS011:cmd()
+// wait for response frame after sending SDS011:cmd(); MCU is kept
+// in idle mode until the frame parser signals a complete frame
 bool SDS011::read(uint8_t cmd, uint8_t data1) {
-    uint8_t i = 0, timeout = 0;
+    PROFILE(PROFILE_SDS011_READ);
     uint32_t startRead = millis();
 
-#ifdef SDS_DEBUG
-    Serial1.printf("SDS011::read(%.2X): ", cmd);
-#endif
-    memset(rxbuf, 0, sizeof(rxbuf));
-	while (++timeout < READ_TIMEOUT_MS && i < 10) {
-        if (Serial2.available() > 0) {
-		    rxbuf[i++] = Serial2.read();
-#ifdef SDS_DEBUG
-            Serial1.printf("%.2X ", rxbuf[i-1]);
-#endif
-            switch (i-1) {
-                case 0: if (rxbuf[0] != 0xAA) { i = 0; } break;
-                case 1: if (rxbuf[1] != cmd) { i = 0; } break;
-                case 2: if (cmd != 0xC0 && rxbuf[2] != data1) { i = 0; } break;
-                case 8: if (!this->checkCRC(rxbuf, rxbuf[8])) { i = 0; } break;
-                case 9: if (rxbuf[9] != 0xAB) { i = 0; } break;
-            }
+    while ((millis() - startRead) < READ_TIMEOUT_MS) {
+        if (rxTail == rxHead) {
+            idle(); // SERCOM1 clock has to keep running, no standby
+            continue;
         }
-        delay(1);
+        memcpy(rxbuf, (const void *)rxFrames[rxTail], SDS011_FRAME_LEN);
+        rxTail = (rxTail + 1) % RX_FRAMES;
+        if (LOG_ENABLED(LOG_DEBUG)) {
+            serial.printf("SDS011::read(%.2X): ", cmd);
+            for (uint8_t i = 0; i < SDS011_FRAME_LEN; i++)
+                serial.printf("%.2X ", rxbuf[i]);
+            serial.printf("(%d ms)\n", millis() - startRead);
+        }
+        // skip unrelated frames (e.g. late reply to previous command)
+        if (rxbuf[1] == cmd && (cmd == 0xC0 || rxbuf[2] == data1))
+            return true;
     }
 
-    if (i != 10) {
-#ifdef SDS_DEBUG
-        Serial1.println();
-#endif
-        log_msg("[WARNING] SDS011 read timeout!");
-        return false;
-    } 
-#ifdef SDS_DEBUG
-    else {
-        Serial1.printf("(%d ms)\n", millis() - startRead);
-    }
-#endif
-    return true;
+    log_warn("[WARNING] SDS011 read timeout!");
+    diag_add(DIAG_SDS011_TIMEOUTS, 1);
+    return false;
 }
 
 
 // ensure warmup time (fan running) before reading PM values
+// with adaptive warmup SDS011 is sampled after WARMUP_MIN_SECS and
+// reports ready as soon as consecutive readings have converged
 bool SDS011::ready() {
-    uint32_t runSecs = (millis() - startTime) / 1000;
-    if ((millis() % 1000) == 0) {
-        log_msg("SDS011 warming up (%d secs)...", (warmupSecs - runSecs));
-        delay(1);
+    uint32_t runSecs = (uptime_ms() - startTime) / 1000;
+
+    if (startTime == 0)
+        return false;
+#ifdef SDS_ADAPTIVE_WARMUP
+    if (!converged && runSecs >= WARMUP_MIN_SECS && runSecs < warmupSecs &&
+            (uptime_ms() - lastSample) >= avgReadingsMs)
+        this->sample();
+    if (converged)
+        return true;
+#endif
+    return runSecs >= warmupSecs;
+}
+
+
+// returns seconds left until SDS011 has to be polled again during
+// warmup, MCU can be put to standby meanwhile (fan keeps running);
+// with adaptive warmup only until sampling starts at WARMUP_MIN_SECS
+uint16_t SDS011::warmupLeft() {
+    uint32_t runSecs = (uptime_ms() - startTime) / 1000;
+
+    if (startTime == 0)
+        return 0;
+#ifdef SDS_ADAPTIVE_WARMUP
+    if (converged || runSecs >= WARMUP_MIN_SECS)
+        return 0;
+    return WARMUP_MIN_SECS - runSecs;
+#else
+    return runSecs < warmupSecs ? warmupSecs - runSecs : 0;
+#endif
+}
+
+
+#ifdef SDS_ADAPTIVE_WARMUP
+// returns true if PM reading (1/10 μg/m3) is within tolerance of previous reading
+static bool sds011_converging(uint16_t pm, uint16_t last) {
+    uint16_t tolerance = max(last * CONVERGE_TOLERANCE_PCT / 100, CONVERGE_TOLERANCE_MIN);
+    return abs((int32_t)pm - (int32_t)last) <= tolerance;
+}
+
+
+// take a reading during warmup; readings are summed up as long as they
+// are in tolerance of the previous one, otherwise start over
+void SDS011::sample() {
+    uint16_t pm25, pm10;
+
+    lastSample = uptime_ms();
+    this->cmd(CMD_QUERY, "sample");
+    if (!this->read(0xC0))
+        return;
+    pm25 = rxbuf[3] << 8 | rxbuf[2];
+    pm10 = rxbuf[5] << 8 | rxbuf[4];
+
+    if (pm25Stats.count == 0 || !sds011_converging(pm25, lastPm25) || !sds011_converging(pm10, lastPm10)) {
+        stats_reset(&pm25Stats);
+        stats_reset(&pm10Stats);
     }
-    return startTime == 0 ? false : runSecs >= warmupSecs;
+    stats_add(&pm25Stats, pm25);
+    stats_add(&pm10Stats, pm10);
+    lastPm25 = pm25;
+    lastPm10 = pm10;
+    converged = (pm25Stats.count >= avgReadings);
+    log_debug("SDS011::sample() %d/%d", pm25Stats.count, avgReadings);
 }
+#endif
 
 
 uint8_t SDS011::calcCRC(uint8_t *buf) {
@@ -215,18 +359,9 @@ uint8_t SDS011::calcCRC(uint8_t *buf) {
 }
 
 
-bool SDS011::checkCRC(uint8_t *buf, uint8_t crc) {
-    uint8_t crc_calc = 0;
-
-    for (uint8_t i = 2; i < 8; ++i) {
-        crc_calc += buf[i];
-    }
-    return crc == crc_calc;
-}
-
-
 // send predefined command sequence with checksum to SDS011 (see cmd stubs above)
 bool SDS011::cmd(const uint8_t *cmd, const char *name) {
+    PROFILE(PROFILE_SDS011_CMD);
     static uint8_t buf[19];
 
     memset(buf, 0, sizeof(buf));
@@ -238,12 +373,13 @@ bool SDS011::cmd(const uint8_t *cmd, const char *name) {
     buf[17] = this->calcCRC(buf);
     buf[18] = 0xAB;
 
-#ifdef SDS_DEBUG
-    Serial1.printf("SDS011::cmd(%s) ", name);
-    for (uint8_t i = 0; i < 19; i++) {
-        Serial1.printf("%.2X ", buf[i]);
+    if (LOG_ENABLED(LOG_DEBUG)) {
+        serial.printf("SDS011::cmd(%s) ", name);
+        for (uint8_t i = 0; i < 19; i++) {
+            serial.printf("%.2X ", buf[i]);
+        }
+        serial.println();
     }
-    Serial1.println();
-#endif
+    rxTail = rxHead; // discard pending response frames
     return Serial2.write(buf, sizeof(buf)) == sizeof(buf);
 }
\ No newline at end of file
@@ -0,0 +1,82 @@
+/***************************************************************************
+  Copyright (c) 2024 Lars Wessels
+
+  This file is part of the "Feather-M0-LoRaWAN-PM-Sensor" source code.
+  https://github.com/lrswss/feather-m0-lorawan-pm-sensor
+
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+   
+  http://www.apache.org/licenses/LICENSE-2.0
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+***************************************************************************/
+
+#include "sds011_parser.h"
+
+
+SDS011Parser::SDS011Parser() {
+    this->reset();
+    frameCount = 0;
+    dropCount = 0;
+}
+
+
+void SDS011Parser::reset() {
+    pos = 0;
+}
+
+
+// feed next received byte; returns pointer to complete frame or NULL
+// frame is only valid until next call of feed() since it is not copied
+const SDS011Frame* SDS011Parser::feed(uint8_t c) {
+    buf[pos++] = c;
+    while (pos > 0 && !this->valid())
+        this->resync();
+    if (pos < SDS011_FRAME_LEN)
+        return NULL;
+
+    pos = 0;
+    frameCount++;
+    return reinterpret_cast<const SDS011Frame*>(buf);
+}
+
+
+// check if bytes received so far can be the beginning of a frame
+bool SDS011Parser::valid() const {
+    uint8_t crc = 0;
+
+    if (buf[0] != SDS011_FRAME_HEAD)
+        return false;
+    if (pos > 1 && buf[1] != SDS011_REPLY_DATA && buf[1] != SDS011_REPLY_CMD)
+        return false;
+    if (pos > 8) {
+        for (uint8_t i = 2; i < 8; i++)
+            crc += buf[i];
+        if (buf[8] != crc)
+            return false;
+    }
+    if (pos > 9 && buf[9] != SDS011_FRAME_TAIL)
+        return false;
+    return true;
+}
+
+
+// on mismatch don't discard all bytes received so far, but restart
+// at the next frame head (e.g. a 0xAA in payload of a broken frame)
+void SDS011Parser::resync() {
+    uint8_t i;
+
+    for (i = 1; i < pos && buf[i] != SDS011_FRAME_HEAD; i++);
+    if (pos > 1)
+        dropCount++;
+    for (uint8_t j = i; j < pos; j++)
+        buf[j - i] = buf[j];
+    pos -= i;
+}
@@ -21,17 +21,31 @@
 #include "sensors.h"
 #include "utils.h"
 #include "config.h"
+#include "rtc.h"
+#include "profile.h"
+#include "nvm.h"
+#include "settings.h"
+
+#define LOG_MODULE LOG_LEVEL_SENSORS
 
 #define I2C Wire
 
 sensorReadings_t sensorReadings = { 
-        -99.0, // temp
-        -1,    // pressure
+        SENSORS_TEMP_INVALID,
+        0,     // pressure
         -1,    // humidity
+        -1,    // pm10
         -1,    // pm2.5
-        -1.0,  // pm10
-        0.0,   // vbat
-        SENSORS_OFFLINE
+        0,     // vbat
+        SENSORS_OFFLINE,
+        0,     // interval
+        0,     // soc
+        BATTERY_NORMAL,
+        0,     // pmSamples
+        { 0, 0, 0 },
+        { 0, 0, 0 },
+        0,     // alert
+        -1     // settingsAck
     };
 
 
@@ -39,27 +53,47 @@ Adafruit_BME280 bme = Adafruit_BME280();
 Adafruit_SHT31 sht31 = Adafruit_SHT31(&I2C);
 Adafruit_Si7021 si7021 = Adafruit_Si7021(&I2C);
 SDS011 sds = SDS011(WARMUP_SECS);
+static bool pmSkipped = false;
+static bool pmActive = false; // SDS011 fan running
+
+// I2C sensor detected on previous startup
+typedef struct {
+    uint32_t magic;
+    uint8_t sensor; // SENSORS_HAS_* flag, 0 if none
+    uint8_t crc; // covers all bytes before
+} sensorsConfig_t;
+
+NVM_AREA(configArea, 1);
+
+
+// convert float from sensor library to fixed-point value
+static int32_t fixed(float value, int16_t scale, int32_t invalid) {
+    return isnan(value) ? invalid : lroundf(value * scale);
+}
 
 
-// read battery voltage using voltage divider
+// read (filtered) battery voltage using voltage divider
+// and update state of charge and power tier
 bool vbat_read(bool verbose) {
 #ifdef VBAT_PIN
-    static char buf[8];
-
-    sensorReadings.vbat  = (analogRead(VBAT_PIN) * VBAT_MULTIPLIER * 3.3) / 1024;
-    dtostrf(sensorReadings.vbat, 4, 2, buf);
-    if (sensorReadings.vbat > 2.55 && sensorReadings.vbat <= VBAT_MAX_LEVEL) {
+    static char buf[12];
+    uint16_t mv = battery_read();
+
+    sensorReadings.vbat = mv;
+    sensorReadings.soc = battery_soc();
+    sensorReadings.power = battery_tier();
+    if (mv > 0) {
+        fixstr(buf, mv / 10, 2);
         if (verbose) {
-            if (sensorReadings.vbat <= VBAT_MIN_LEVEL)
-                log_msg("[WARNING] low battery voltage: %s V", buf);
+            if (sensorReadings.power != BATTERY_NORMAL)
+                log_warn("[WARNING] low battery voltage: %s V (%d%%)", buf, sensorReadings.soc);
             else
-                log_msg("Battery voltage: %s V", buf);
+                log_info("Battery voltage: %s V (%d%%)", buf, sensorReadings.soc);
         }
         return true;
     } else {
-        sensorReadings.vbat = 0.0;
         if (verbose) {
-            log_msg("No battery connected or currently charging");
+            log_info("No battery connected or currently charging");
         }
         return false;
     }
@@ -68,53 +102,93 @@ bool vbat_read(bool verbose) {
 }
 
 
-// start and scan I2C for devices
-// return number of devices found
-static uint8_t i2c_init() {
-  uint8_t addr, error, devices = 0;
+// address a device on the I2C bus, returns 0 if it
+// acknowledged, 4 on bus error (see endTransmission())
+static uint8_t i2c_probe(uint8_t addr) {
+    I2C.beginTransmission(addr);
+    return I2C.endTransmission();
+}
 
-    I2C.begin();
-    log_msg("Scanning I2C bus...");
-    for (addr = 1; addr < 127; addr++) {
-        I2C.beginTransmission(addr);
-        error = I2C.endTransmission();
-        if (error == 0) {
-            log_msg("Found I2C device at address 0x%02X", addr);
+
+#ifdef I2C_SCAN
+// probe all addresses on I2C bus and log devices found
+static void i2c_scan() {
+    uint8_t devices = 0;
+
+    log_info("Scanning I2C bus...");
+    for (uint8_t addr = 1; addr < 127; addr++) {
+        if (i2c_probe(addr) == 0) {
+            log_info("Found I2C device at address 0x%02X", addr);
             devices++;
-            if (devices > 5) {
-                log_msg("[WARNING] Too many I2C devices detected (I2C bus error)");
-                sensorReadings.status |= SENSORS_I2C_ERROR;
-                return 0;
-            }
+        }
+    }
+    log_info("Found %d I2C devices", devices);
+}
+#endif
+
+
+// probe addresses of supported sensors, returns their SENSORS_HAS_*
+// flags (0 if none has been found or on bus error)
+static uint8_t i2c_detect() {
+    const uint8_t addrs[] = { BMP_BME280_ADDRESS, SHT31_ADDRESS, SI7021_ADDRESS };
+    const uint8_t flags[] = { SENSORS_HAS_BME280, SENSORS_HAS_SHT31, SENSORS_HAS_SI7021 };
+    uint8_t found = 0, error;
+
+    for (uint8_t i = 0; i < sizeof(addrs); i++) {
+        error = i2c_probe(addrs[i]);
+        if (error == 0) {
+            log_debug("Found I2C device at address 0x%02X", addrs[i]);
+            found |= flags[i];
         } else if (error == 4) {
-            log_msg("[WARNING] Unknown I2C error for device address 0x%02X", addr);
+            log_warn("[WARNING] Unknown I2C error for device address 0x%02X", addrs[i]);
             sensorReadings.status |= SENSORS_I2C_ERROR;
             return 0;
         }
     }
-    if (devices == 0)
-        log_msg("[WARNING] No I2C devices found!");
-    else
-        log_msg("Found %d devices", devices);
-    return devices;
+    if (found == 0)
+        log_warn("[WARNING] No I2C sensor found!");
+    else if (found & (found - 1))
+        log_warn("[WARNING] Found more than one I2C sensor, will only use one!");
+    return found;
+}
+
+
+// returns I2C sensor saved in flash (SENSORS_HAS_* flag, 0 if none)
+static uint8_t sensors_config() {
+    sensorsConfig_t config;
+
+    nvm_read(configArea, &config, sizeof(config));
+    if (config.magic != SENSORS_CONFIG_MAGIC ||
+            config.crc != crc8((uint8_t *)&config, offsetof(sensorsConfig_t, crc)))
+        return 0;
+    return config.sensor;
+}
+
+
+// save I2C sensor in flash for next startup
+static void sensors_save(uint8_t sensor) {
+    sensorsConfig_t config;
+
+    memset(&config, 0, sizeof(config));
+    config.magic = SENSORS_CONFIG_MAGIC;
+    config.sensor = sensor;
+    config.crc = crc8((uint8_t *)&config, offsetof(sensorsConfig_t, crc));
+    nvm_erase(configArea);
+    nvm_write(configArea, &config, sizeof(config));
+    log_debug("Saved I2C sensor configuration (0x%02X)", sensor);
 }
 
 
 // initialize BME-Sensor
 static bool bme280_init() {
     if (!bme.begin(BMP_BME280_ADDRESS, &I2C)) {
-        log_msg("Sensor BMP280 or BME280 not found!");
+        log_warn("Sensor BMP280 or BME280 not found!");
         return false;
     }
 
-    switch (bme.sensorID()) {
-        case 0x60:
-            log_msg("Sensor BME280 (Temp/Hum/Pres) ready");
-            sensorReadings.status |= SENSORS_HAS_BME280;
-            return true;
-        default:
-            log_msg("Found UNKNOWN sensor!");
-            return false;
+    if (bme.sensorID() != 0x60) {
+        log_warn("Found UNKNOWN sensor!");
+        return false;
     }
 
     // setting for weather station
@@ -125,6 +199,8 @@ static bool bme280_init() {
                     Adafruit_BME280::SAMPLING_X1, // humidity
                     Adafruit_BME280::FILTER_OFF);
 
+    log_info("Sensor BME280 (Temp/Hum/Pres) ready");
+    sensorReadings.status |= SENSORS_HAS_BME280;
     return true;
 }
 
@@ -132,20 +208,62 @@ static bool bme280_init() {
 // put BME280 to sleep
 // https://github.com/G6EJD/BME280-Sleep-and-Address-change
 static void bme280_sleep() {
-    I2C.beginTransmission(BME280_ADDRESS);
+    I2C.beginTransmission(BMP_BME280_ADDRESS);
     I2C.write((uint8_t)0xF4);
     I2C.write((uint8_t)0b00000000);
     I2C.endTransmission();
 }
 
 
+// trigger single measurement in forced mode without waiting for result
+// (ctrl_meas: 1x oversampling for temperature and pressure)
+static void bme280_start() {
+    I2C.beginTransmission(BMP_BME280_ADDRESS);
+    I2C.write((uint8_t)0xF4);
+    I2C.write((uint8_t)0b00100101);
+    I2C.endTransmission();
+}
+
+
+// send command (8 or 16 bit) to I2C device
+static bool i2c_command(uint8_t addr, uint16_t cmd, bool word) {
+    I2C.beginTransmission(addr);
+    if (word)
+        I2C.write((uint8_t)(cmd >> 8));
+    I2C.write((uint8_t)(cmd & 0xFF));
+    return I2C.endTransmission() == 0;
+}
+
+
+// read given number of bytes from I2C device, returns false
+// if device did not acknowledge (e.g. conversion not finished)
+static bool i2c_read(uint8_t addr, uint8_t *buf, uint8_t len) {
+    if (I2C.requestFrom(addr, len) != len)
+        return false;
+    for (uint8_t i = 0; i < len; i++)
+        buf[i] = I2C.read();
+    return true;
+}
+
+
+// CRC-8 (polynomial 0x31) used by Sensirion and Silicon Labs sensors
+static uint8_t i2c_crc(const uint8_t *buf, uint8_t len, uint8_t crc) {
+    while (len--) {
+        crc ^= *buf++;
+        for (uint8_t i = 0; i < 8; i++)
+            crc = (crc & 0x80) ? (crc << 1) ^ 0x31 : (crc << 1);
+    }
+    return crc;
+}
+
+
 // initialize SHT31 temperature/humidity sensor
 static bool sht31_init() {
     if (!sht31.begin(SHT31_ADDRESS)) {
-        log_msg("Sensor SHT31 not found!");
+        log_warn("Sensor SHT31 not found!");
         return false;
     }
-    log_msg("Sensor SHT31 (Temp/Hum) ready");
+    log_info("Sensor SHT31 (Temp/Hum) ready");
     sensorReadings.status |= SENSORS_HAS_SHT31;
     return true;
 }
@@ -156,11 +274,12 @@ static bool sds011_init() {
     uint16_t sensorid;
 
     sds.begin();
+    pmActive = true;
     if (sds.info(version, sensorid)) {
-        log_msg("Sensor SDS011 %d v%s (PM2.5/PM10) ready", sensorid, version);
+        log_info("Sensor SDS011 %d v%s (PM2.5/PM10) ready", sensorid, version);
         return true;
     }
-    log_msg("Sensor SDS011 not found!") ;
+    log_warn("Sensor SDS011 not found!") ;
     return false;
 }
 
@@ -168,164 +287,272 @@ static bool sds011_init() {
 // initialize SI7021 temperature/humidity sensor
 static bool si7021_init() {
     if (!si7021.begin()) {
-        log_msg("Sensor SI7021 not found!");
+        log_warn("Sensor SI7021 not found!");
         return false;
     }
-    log_msg("Sensor SI7021 v%d (Temp/Hum) ready", si7021.getRevision());
+    log_info("Sensor SI7021 v%d (Temp/Hum) ready", si7021.getRevision());
     sensorReadings.status |= SENSORS_HAS_SI7021;
     return true;
 }
 
 
-// get readings for BME280 (temperature, humidity, pressure)
-static void bme280_readings(bool verbose) {
-    bme.takeForcedMeasurement();
-    sensorReadings.pressure = bme.readPressure() / 100.0F;  // hPa
-    sensorReadings.temperature = bme.readTemperature();  // °C
-    sensorReadings.humidity = int(bme.readHumidity()); // %
-
-    if (isnan(sensorReadings.temperature)) {
-        serial.println("BME280: failed to read temperature!");
-        sensorReadings.temperature = -99.0;
-    }
-    if (isnan(sensorReadings.humidity)) {
-        serial.println("BME280: failed to read humidity!");
-        sensorReadings.humidity = -1.0;
-    }
-    if (isnan(sensorReadings.pressure)) {
-        serial.println("BME280: failed to read pressure!");
-        sensorReadings.humidity = -1.0;
-    }
+// print temperature and humidity (and pressure if available)
+static void sensors_print(bool pressure) {
+    char buf[12];
 
-    if (!verbose)
+    if (!LOG_ENABLED(LOG_INFO))
         return;
-    serial.print("- Temperature: ");
-    serial.print(sensorReadings.temperature, 2);
+    serial.print(F("- Temperature: "));
+    serial.print(fixstr(buf, sensorReadings.temperature, 2));
     serial.println(" C");
-    serial.print("- Humidity: ");
+    serial.print(F("- Humidity: "));
     serial.print(sensorReadings.humidity);
-    serial.println(" %");
-    serial.print("- Pressure: ");
-    serial.print(sensorReadings.pressure, 1);
+    serial.println(F(" %"));
+    if (!pressure)
+        return;
+    serial.print(F("- Pressure: "));
+    serial.print(fixstr(buf, sensorReadings.pressure, 1));
     serial.println(" hPa");
 }
 
 
+// get readings for BME280 (temperature, humidity, pressure)
+// (conversion has been started with bme280_start())
+static void bme280_readings(bool verbose) {
+    PROFILE(PROFILE_I2C_READ);
+    sensorReadings.pressure = (fixed(bme.readPressure(), 1, -5) + 5) / 10;  // Pa -> hPa * 10
+    sensorReadings.temperature = fixed(bme.readTemperature(), 100, SENSORS_TEMP_INVALID);
+    sensorReadings.humidity = fixed(bme.readHumidity(), 1, -1);
+
+    if (sensorReadings.temperature == SENSORS_TEMP_INVALID)
+        log_warn("BME280: failed to read temperature!");
+    if (sensorReadings.humidity < 0)
+        log_warn("BME280: failed to read humidity!");
+    if (sensorReadings.pressure == 0)
+        log_warn("BME280: failed to read pressure!");
+
+    if (verbose)
+        sensors_print(true);
+}
+
+
+// trigger single shot measurement on SHT31 without waiting for
+// result (high repeatability, no clock stretching)
+static void sht31_start() {
+    i2c_command(SHT31_ADDRESS, 0x2400, true);
+}
+
+
 // get readings for (temperature, humidity) from SHT31
+// (conversion has been started with sht31_start())
 static void sht31_readings(bool verbose) {
-    sensorReadings.temperature = sht31.readTemperature();
-    sensorReadings.humidity = sht31.readHumidity();
-    if (isnan(sensorReadings.temperature)) {
-        serial.println("SHT31: failed to read temperature!");
-        sensorReadings.temperature = -99.0;
-    }
-    if (isnan(sensorReadings.humidity)) {
-        serial.println("SHT31: failed to read humidity!");
-        sensorReadings.humidity = -1.0;
+    PROFILE(PROFILE_I2C_READ);
+    uint8_t buf[6];
+
+    sensorReadings.temperature = SENSORS_TEMP_INVALID;
+    sensorReadings.humidity = -1;
+    if (i2c_read(SHT31_ADDRESS, buf, sizeof(buf))) {
+        if (i2c_crc(buf, 2, 0xFF) == buf[2])
+            sensorReadings.temperature = (17500L * (buf[0] << 8 | buf[1])) / 65535 - 4500;
+        if (i2c_crc(buf + 3, 2, 0xFF) == buf[5])
+            sensorReadings.humidity = (100L * (buf[3] << 8 | buf[4]) + 32767) / 65535;
     }
+    if (sensorReadings.temperature == SENSORS_TEMP_INVALID)
+        log_warn("SHT31: failed to read temperature!");
+    if (sensorReadings.humidity < 0)
+        log_warn("SHT31: failed to read humidity!");
 
-    if (!verbose)
-        return;
-    serial.print(F("- Temperature: "));
-    serial.print(sensorReadings.temperature, 2);
-    serial.println(" C");
-    serial.print(F("- Humidity: "));
-    serial.print(sensorReadings.humidity);
-    serial.println(F(" %"));
+    if (verbose)
+        sensors_print(false);
+}
+
+
+// trigger humidity (and temperature) measurement on SI7021
+// without waiting for result (no hold master mode)
+static void si7021_start() {
+    i2c_command(SI7021_ADDRESS, 0xF5, false);
 }
 
 
-// get readings for (temperature, humidity) from SI7021
+// get readings for (temperature, humidity) from SI7021, temperature
+// is taken from humidity measurement started with si7021_start()
 static void si7021_readings(bool verbose) {
-    sensorReadings.temperature = si7021.readTemperature();
-    sensorReadings.humidity = si7021.readHumidity();
-    if (isnan(sensorReadings.temperature)) {
-        serial.println("SI7021: failed to read temperature!");
-        sensorReadings.temperature = -99.0;
-    }
-    if (isnan(sensorReadings.humidity)) {
-        serial.println("SI7021: failed to read humidity!");
-        sensorReadings.humidity = -1.0;
-    }
+    PROFILE(PROFILE_I2C_READ);
+    uint8_t buf[3];
+
+    sensorReadings.temperature = SENSORS_TEMP_INVALID;
+    sensorReadings.humidity = -1;
+    if (i2c_read(SI7021_ADDRESS, buf, 3) && i2c_crc(buf, 2, 0x00) == buf[2])
+        sensorReadings.humidity = constrain(((125L * (buf[0] << 8 | buf[1])) >> 16) - 6, 0, 100);
+    if (i2c_command(SI7021_ADDRESS, 0xE0, false) && i2c_read(SI7021_ADDRESS, buf, 2))
+        sensorReadings.temperature = ((17572L * (buf[0] << 8 | buf[1])) >> 16) - 4685;
+    if (sensorReadings.temperature == SENSORS_TEMP_INVALID)
+        log_warn("SI7021: failed to read temperature!");
+    if (sensorReadings.humidity < 0)
+        log_warn("SI7021: failed to read humidity!");
+
+    if (verbose)
+        sensors_print(false);
+}
 
-    if (!verbose)
-        return;
-    serial.print(F("- Temperature: "));
-    serial.print(sensorReadings.temperature, 2);
-    serial.println(" C");
-    serial.print(F("- Humidity: "));
-    serial.print(sensorReadings.humidity);
-    serial.println(F(" %"));
+
+// start conversion of temperature/humidity sensor, returns
+// time (ms) until results are available
+static uint8_t i2c_start() {
+    if (sensorReadings.status & SENSORS_HAS_BME280) {
+        bme280_start();
+        return BME280_CONV_MS;
+    } else if (sensorReadings.status & SENSORS_HAS_SHT31) {
+        sht31_start();
+        return SHT31_CONV_MS;
+    } else if (sensorReadings.status & SENSORS_HAS_SI7021) {
+        si7021_start();
+        return SI7021_CONV_MS;
+    }
+    return 0;
 }
 
 
 static void sds011_readings(bool verbose) {
-    sds.poll(&sensorReadings.pm25, &sensorReadings.pm10, AVG_READINGS);
+    char buf[12];
+
+    sensorReadings.pmSamples = 0;
+    if (sds.poll(&sensorReadings.pm25, &sensorReadings.pm10, settings.readings)) {
+        log_info("SDS011 averaged %d readings, fan running for %d secs",
+            sds.pollSamples(), sds.pollSecs());
+        sensorReadings.pmSamples = sds.pollSamples();
+        sds.pollStats(&sensorReadings.pm25Stats, &sensorReadings.pm10Stats);
+        log_debug("SDS011 PM2.5 min/max/stddev: %d/%d/%d, PM10: %d/%d/%d",
+            sensorReadings.pm25Stats.min, sensorReadings.pm25Stats.max, sensorReadings.pm25Stats.stddev,
+            sensorReadings.pm10Stats.min, sensorReadings.pm10Stats.max, sensorReadings.pm10Stats.stddev);
+    } else {
+        // don't send readings of last cycle, PM is reported as missing
+        log_warn("[WARNING] SDS011 readings failed!");
+        sensorReadings.pm25 = -1;
+        sensorReadings.pm10 = -1;
+    }
 
-    if (!verbose)
+    if (!verbose || !LOG_ENABLED(LOG_INFO) || sensorReadings.pm25 < 0)
         return;
     serial.print(F("- PM 2.5: "));
-    serial.print(sensorReadings.pm25, 2);
+    serial.print(fixstr(buf, sensorReadings.pm25, 1));
     serial.println(" μg/m3");
     serial.print(F("- PM 10: "));
-    serial.print(sensorReadings.pm10, 2);
+    serial.print(fixstr(buf, sensorReadings.pm10, 1));
     serial.println(F(" μg/m3"));
 
 }
 
 
-// start I2C bus and check for (right) number of devices
-// and initialize all available sensors
+// initialize I2C sensor given by its SENSORS_HAS_* flag
+static bool i2c_sensor_init(uint8_t sensor) {
+    switch (sensor) {
+        case SENSORS_HAS_BME280: return bme280_init();
+        case SENSORS_HAS_SHT31: return sht31_init();
+        case SENSORS_HAS_SI7021: return si7021_init();
+    }
+    return false;
+}
+
+
+// start I2C bus and initialize I2C sensor found on last startup, otherwise
+// probe addresses of supported sensors; initialize SDS011
 void sensors_init() {
-    uint8_t devices = i2c_init();
-    if (devices == 0)
-        return;
-    if (devices > 1)
-        log_msg("[WARNING] Found more than one I2C sensor, will only use one!");
-    if (!bme280_init()) {
-        if (!sht31_init()) {
-            if (!si7021_init())
-                sensorReadings.status |= SENSORS_I2C_FAILED;
+    uint32_t start = millis();
+    uint8_t cached = sensors_config(), sensor = 0, found;
+
+    I2C.begin();
+    I2C.setClock(I2C_CLOCK_HZ);
+#ifdef I2C_SCAN
+    i2c_scan();
+#endif
+    if (cached != 0 && i2c_sensor_init(cached)) {
+        sensor = cached;
+    } else {
+        found = i2c_detect();
+        for (uint8_t flag = SENSORS_HAS_BME280; flag != 0 && sensor == 0; flag <<= 1) {
+            if ((found & flag) && i2c_sensor_init(flag))
+                sensor = flag;
         }
+        if (found != 0 && sensor == 0)
+            sensorReadings.status |= SENSORS_I2C_FAILED;
+        if (sensor != cached)
+            sensors_save(sensor);
     }
+    I2C.setClock(I2C_CLOCK_HZ); // sensor libraries restart bus at 100 kHz
+
     if (!sds011_init())
         sensorReadings.status |= SENSORS_SDS011_ERROR;
     sensorReadings.status |= SENSORS_INITED;
+    log_info("Sensors initialized in %ld ms", millis() - start);
 }
 
 
-// fill global struct sensorReadings with current value
-// returns true if current wind speed is available
+// fill global struct sensorReadings with current values; conversion of
+// temperature/humidity sensor runs while SDS011 is polled, SDS011 is
+// turned off before results are collected to shorten its fan runtime
 void sensors_read(bool verbose) {
-    log_msg("Reading sensors...");
+    uint32_t start = millis(), pmStart, i2cStart;
+    uint8_t conversion;
+
+    log_debug("Reading sensors...");
+    conversion = i2c_start();
+
+    pmStart = millis();
+    if ((sensorReadings.status & SENSORS_SDS011_ERROR) == 0) {
+        if (pmSkipped) {
+            log_info("Skipping SDS011 readings to save battery");
+            sensorReadings.pm25 = -1;
+            sensorReadings.pm10 = -1;
+            sensorReadings.pmSamples = 0;
+        } else {
+            sds011_readings(verbose);
+            sds.sleep();
+            pmActive = false;
+        }
+    }
 
-    if ((sensorReadings.status & SENSORS_SDS011_ERROR) == 0)
-        sds011_readings(verbose);
-    if (sensorReadings.status & SENSORS_HAS_BME280) {
+    i2cStart = millis();
+    while ((millis() - start) < conversion)
+        idle();
+    if (sensorReadings.status & SENSORS_HAS_BME280)
         bme280_readings(verbose);
-        return;
-    } else if (sensorReadings.status & SENSORS_HAS_SHT31) {
+    else if (sensorReadings.status & SENSORS_HAS_SHT31)
         sht31_readings(verbose);
-        return;
-    } else if (sensorReadings.status & SENSORS_HAS_SI7021) {
+    else if (sensorReadings.status & SENSORS_HAS_SI7021)
         si7021_readings(verbose);
-        return;
-    }
-    log_msg("[WARNING] Skipping temperature/humidity readings, not ready!");
+    else
+        log_warn("[WARNING] Skipping temperature/humidity readings, not ready!");
+
+    log_debug("Sensors read in %ld ms (I2C start: %ld ms, SDS011: %ld ms, I2C collect: %ld ms)",
+        millis() - start, pmStart - start, i2cStart - pmStart, millis() - i2cStart);
 }
 
 
 // check if sensors are reading for reading data
 // SDS011 requires about 30 sec. warmup time after sleep mode
 bool sensors_ready() {
-    return (sensorReadings.status & SENSORS_SDS011_ERROR) == 0 && sds.ready();
+    return (sensorReadings.status & SENSORS_SDS011_ERROR) == 0 && (pmSkipped || sds.ready());
 }
 
 
-// turn on or reset sensors
+// seconds the MCU can stay in standby while SDS011 is warming up
+uint16_t sensors_warmup_secs() {
+    if ((sensorReadings.status & SENSORS_SDS011_ERROR) || pmSkipped)
+        return 0;
+    return sds.warmupLeft();
+}
+
+
+// turn on or reset sensors, SDS011 stays off if
+// battery is low (see battery_skip_pm())
 void sensors_warmup() {
-    if ((sensorReadings.status & SENSORS_SDS011_ERROR) == 0)
+    pmSkipped = battery_skip_pm();
+    if ((sensorReadings.status & SENSORS_SDS011_ERROR) == 0 && !pmSkipped) {
+        sds.configure(settings.warmupSecs, settings.readings, settings.readingsMs);
         sds.wakeup();
+        pmActive = true;
+    }
     if (sensorReadings.status & SENSORS_HAS_SHT31)
         sht31.reset();
     if (sensorReadings.status & SENSORS_HAS_SI7021)
@@ -336,8 +563,10 @@ void sensors_warmup() {
 
 // turn off sensors (if supported)
 void sensors_off() {
-    if ((sensorReadings.status & SENSORS_SDS011_ERROR) == 0)
+    if ((sensorReadings.status & SENSORS_SDS011_ERROR) == 0 && pmActive) {
         sds.sleep();
+        pmActive = false;
+    }
     if (sensorReadings.status & SENSORS_HAS_BME280)
         bme280_sleep();
     if ((sensorReadings.status & SENSORS_HAS_SHT31) && (sensorReadings.humidity > 90)) {
@@ -0,0 +1,180 @@
+/***************************************************************************
+  Copyright (c) 2024 Lars Wessels
+
+  This file is part of the "Feather-M0-LoRaWAN-PM-Sensor" source code.
+  https://github.com/lrswss/feather-m0-lorawan-pm-sensor
+
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+   
+  http://www.apache.org/licenses/LICENSE-2.0
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+***************************************************************************/
+
+#include "session.h"
+#include "lorawan.h"
+#include "nvm.h"
+#include "utils.h"
+
+#define LOG_MODULE LOG_LEVEL_LORAWAN
+
+typedef struct {
+    uint32_t magic;
+    uint32_t seqno; // incremented with every save
+    uint32_t netid;
+    uint32_t devaddr; // 0 if session has been cleared
+    uint8_t nwkKey[16];
+    uint8_t artKey[16];
+    uint32_t seqnoUp;
+    uint32_t seqnoDn;
+    uint32_t channelFreq[MAX_CHANNELS];
+    uint16_t channelDrMap[MAX_CHANNELS];
+    uint16_t channelMap;
+    uint16_t devNonce;
+    uint32_t dn2Freq;
+    uint8_t dn2Dr;
+    uint8_t rx1DrOffset;
+    uint8_t rxDelay;
+    uint8_t datarate;
+    int8_t txpow;
+    uint8_t crc; // covers all bytes before
+} lorawanSession_t;
+
+NVM_AREA(sessionArea, SESSION_ROWS);
+
+static uint32_t sessionSeqno = 0;
+static uint8_t sessionRow = 0;
+static uint32_t savedSeqnoUp = 0;
+static uint16_t savedDevNonce = 0;
+
+
+static bool session_read(uint8_t row, lorawanSession_t *session) {
+    nvm_read(sessionArea + row * NVM_ROW_SIZE, session, sizeof(lorawanSession_t));
+    return session->magic == SESSION_MAGIC &&
+        session->crc == crc8((uint8_t *)session, offsetof(lorawanSession_t, crc));
+}
+
+
+// write session to next flash row
+static void session_write(lorawanSession_t *session) {
+    static_assert(sizeof(lorawanSession_t) <= NVM_ROW_SIZE, "lorawanSession_t must fit into a flash row");
+    sessionRow = (sessionRow + 1) % SESSION_ROWS;
+    session->magic = SESSION_MAGIC;
+    session->seqno = ++sessionSeqno;
+    session->crc = crc8((uint8_t *)session, offsetof(lorawanSession_t, crc));
+    nvm_erase(sessionArea + sessionRow * NVM_ROW_SIZE);
+    nvm_write(sessionArea + sessionRow * NVM_ROW_SIZE, session, sizeof(lorawanSession_t));
+}
+
+
+// returns DevNonce to be saved, reserves further nonces if
+// LMIC has reached the one saved before
+static uint16_t session_nonce() {
+    if (LMIC.devNonce >= savedDevNonce)
+        savedDevNonce = LMIC.devNonce + SESSION_NONCE_RESERVE;
+    return savedDevNonce;
+}
+
+
+// restore latest session saved in flash (requires LMIC_reset() before)
+// returns false if there is no valid session; DevNonce is restored anyway
+bool session_restore() {
+    lorawanSession_t session, latest;
+    bool found = false;
+
+    for (uint8_t row = 0; row < SESSION_ROWS; row++) {
+        if (session_read(row, &session) && session.seqno >= sessionSeqno) {
+            sessionSeqno = session.seqno;
+            sessionRow = row;
+            latest = session;
+            found = true;
+        }
+    }
+    if (!found)
+        return false;
+
+    LMIC.devNonce = savedDevNonce = latest.devNonce;
+    if (latest.devaddr == 0)
+        return false;
+
+    LMIC_setSession(latest.netid, latest.devaddr, latest.nwkKey, latest.artKey);
+    LMIC.seqnoUp = latest.seqnoUp + LORAWAN_SESSION_SAVE;
+    LMIC.seqnoDn = latest.seqnoDn;
+    memcpy(LMIC.channelFreq, latest.channelFreq, sizeof(latest.channelFreq));
+    memcpy(LMIC.channelDrMap, latest.channelDrMap, sizeof(latest.channelDrMap));
+    LMIC.channelMap = latest.channelMap;
+    LMIC.dn2Freq = latest.dn2Freq;
+    LMIC.dn2Dr = latest.dn2Dr;
+    LMIC.rx1DrOffset = latest.rx1DrOffset;
+    LMIC.rxDelay = latest.rxDelay;
+    LMIC_setDrTxpow(latest.datarate, latest.txpow);
+    savedSeqnoUp = LMIC.seqnoUp;
+    log_info("Restored LoRaWAN session %06lX (uplink counter %ld)", latest.devaddr, LMIC.seqnoUp);
+    return true;
+}
+
+
+// save current LMIC session to flash
+void session_save() {
+    lorawanSession_t session;
+
+    memset(&session, 0, sizeof(session));
+    session.netid = LMIC.netid;
+    session.devaddr = LMIC.devaddr;
+    memcpy(session.nwkKey, LMIC.nwkKey, sizeof(session.nwkKey));
+    memcpy(session.artKey, LMIC.artKey, sizeof(session.artKey));
+    session.seqnoUp = LMIC.seqnoUp;
+    session.seqnoDn = LMIC.seqnoDn;
+    memcpy(session.channelFreq, LMIC.channelFreq, sizeof(session.channelFreq));
+    memcpy(session.channelDrMap, LMIC.channelDrMap, sizeof(session.channelDrMap));
+    session.channelMap = LMIC.channelMap;
+    session.devNonce = session_nonce();
+    session.dn2Freq = LMIC.dn2Freq;
+    session.dn2Dr = LMIC.dn2Dr;
+    session.rx1DrOffset = LMIC.rx1DrOffset;
+    session.rxDelay = LMIC.rxDelay;
+    session.datarate = LMIC.datarate;
+    session.txpow = LMIC.adrTxPow;
+    session_write(&session);
+    savedSeqnoUp = LMIC.seqnoUp;
+    log_info("Saved LoRaWAN session (uplink counter %ld)", LMIC.seqnoUp);
+}
+
+
+// invalidate saved session to force a new join after reset,
+// DevNonce is kept to avoid reusing it on next join
+void session_clear() {
+    lorawanSession_t session;
+
+    memset(&session, 0, sizeof(session));
+    session.devNonce = session_nonce();
+    session_write(&session);
+    log_info("Cleared saved LoRaWAN session");
+}
+
+
+// called before a join request is sent, saves DevNonce (with a cleared
+// session) if the nonces reserved in flash have been used up
+void session_joining() {
+    lorawanSession_t session;
+
+    if (LMIC.devNonce < savedDevNonce)
+        return;
+    memset(&session, 0, sizeof(session));
+    session.devNonce = session_nonce();
+    session_write(&session);
+    log_debug("Saved DevNonce %d", session.devNonce);
+}
+
+
+// returns true if session should be saved again
+bool session_due() {
+    return (LMIC.seqnoUp - savedSeqnoUp) >= LORAWAN_SESSION_SAVE;
+}
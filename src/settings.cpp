@@ -0,0 +1,173 @@
+/***************************************************************************
+  Copyright (c) 2024 Lars Wessels
+
+  This file is part of the "Feather-M0-LoRaWAN-PM-Sensor" source code.
+  https://github.com/lrswss/feather-m0-lorawan-pm-sensor
+
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+   
+  http://www.apache.org/licenses/LICENSE-2.0
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+***************************************************************************/
+
+#include "settings.h"
+#include "interval.h"
+#include "nvm.h"
+#include "utils.h"
+
+#define LOG_MODULE LOG_LEVEL_SYSTEM
+
+static const settings_t defaults = {
+    OBSERVATION_INTERVAL_SECS,
+    WARMUP_SECS,
+    AVG_READINGS,
+    AVG_READINGS_MS,
+    SETTINGS_FIELDS
+};
+
+settings_t settings = defaults;
+
+#ifdef REMOTE_SETTINGS
+typedef struct {
+    uint32_t magic;
+    uint8_t revision; // incremented with every change
+    settings_t settings;
+    uint8_t crc; // covers all bytes before
+} settingsRecord_t;
+
+NVM_AREA(settingsArea, 1);
+
+static uint8_t revision = 0;
+static int16_t ack = -1; // not yet reported with observation
+
+
+// returns true if all settings are within bounds
+static bool settings_valid(const settings_t *s) {
+    return s->interval >= OBSERVATION_INTERVAL_MIN_SECS && s->interval <= OBSERVATION_INTERVAL_MAX_SECS &&
+        s->warmupSecs >= SETTINGS_WARMUP_MIN && s->warmupSecs <= SETTINGS_WARMUP_MAX &&
+        s->readings >= SETTINGS_READINGS_MIN && s->readings <= SETTINGS_READINGS_MAX &&
+        s->readingsMs >= SETTINGS_READINGS_MS_MIN && s->readingsMs <= SETTINGS_READINGS_MS_MAX &&
+        (s->fields & ~SETTINGS_FIELDS) == 0;
+}
+
+
+static void settings_print(const char *msg) {
+    log_info("%s (revision %d): interval %d secs, warmup %d secs, %d readings every %d ms, fields 0x%02X",
+        msg, revision, settings.interval, settings.warmupSecs, settings.readings,
+        settings.readingsMs, settings.fields);
+}
+
+
+// restore settings saved in flash (if valid), otherwise keep defaults
+void settings_init() {
+    settingsRecord_t record;
+
+    nvm_read(settingsArea, &record, sizeof(record));
+    if (record.magic != SETTINGS_MAGIC ||
+            record.crc != crc8((uint8_t *)&record, offsetof(settingsRecord_t, crc)) ||
+            !settings_valid(&record.settings))
+        return;
+    settings = record.settings;
+    revision = record.revision;
+    settings_print("Restored settings");
+}
+
+
+static void settings_save() {
+    settingsRecord_t record;
+
+    memset(&record, 0, sizeof(record));
+    record.magic = SETTINGS_MAGIC;
+    record.revision = revision;
+    record.settings = settings;
+    record.crc = crc8((uint8_t *)&record, offsetof(settingsRecord_t, crc));
+    nvm_erase(settingsArea);
+    nvm_write(settingsArea, &record, sizeof(record));
+}
+
+
+// read big endian value of given size (bytes) at buf[*i],
+// returns false if downlink is too short
+static bool settings_value(const uint8_t *buf, uint8_t len, uint8_t *i, uint8_t size, uint16_t *value) {
+    if (*i + size > len)
+        return false;
+    *value = (size == 2) ? (buf[*i] << 8 | buf[*i + 1]) : buf[*i];
+    *i += size;
+    return true;
+}
+
+
+// parse and validate commands of downlink on SETTINGS_PORT (see settings.h),
+// apply and save settings only if all of them are valid
+void settings_downlink(const uint8_t *buf, uint8_t len) {
+    settings_t next = settings;
+    uint16_t value = 0;
+    uint8_t i = 0, cmd;
+    bool valid = (len > 0);
+
+    while (valid && i < len) {
+        cmd = buf[i++];
+        switch (cmd) {
+            case SETTINGS_CMD_INTERVAL:
+                valid = settings_value(buf, len, &i, 2, &value);
+                next.interval = value;
+                break;
+            case SETTINGS_CMD_WARMUP:
+                valid = settings_value(buf, len, &i, 1, &value);
+                next.warmupSecs = value;
+                break;
+            case SETTINGS_CMD_READINGS:
+                valid = settings_value(buf, len, &i, 1, &value);
+                next.readings = value;
+                break;
+            case SETTINGS_CMD_READINGS_MS:
+                valid = settings_value(buf, len, &i, 2, &value);
+                next.readingsMs = value;
+                break;
+            case SETTINGS_CMD_FIELDS:
+                valid = settings_value(buf, len, &i, 1, &value);
+                next.fields = value;
+                break;
+            case SETTINGS_CMD_DEFAULTS:
+                next = defaults;
+                break;
+            default:
+                log_warn("[WARNING] Unknown settings command 0x%02X", cmd);
+                valid = false;
+        }
+    }
+
+    if (!valid || !settings_valid(&next)) {
+        log_warn("[WARNING] Rejected settings downlink (%d bytes)", len);
+        ack = revision;
+        return;
+    }
+    if (memcmp(&next, &settings, sizeof(settings)) != 0) {
+        revision = (revision + 1) & 0x7F;
+        if (next.interval != settings.interval)
+            interval_reset();
+        settings = next;
+        settings_save();
+    }
+    ack = SETTINGS_ACK_APPLIED | revision;
+    settings_print("Applied settings");
+}
+
+
+// returns acknowledge of last settings downlink (see settings.h)
+// once, -1 if there is none to report
+int16_t settings_ack() {
+    int16_t result = ack;
+
+    ack = -1;
+    return result;
+}
+#endif
@@ -0,0 +1,100 @@
+/***************************************************************************
+  Copyright (c) 2024 Lars Wessels
+
+  This file is part of the "Feather-M0-LoRaWAN-PM-Sensor" source code.
+  https://github.com/lrswss/feather-m0-lorawan-pm-sensor
+
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+   
+  http://www.apache.org/licenses/LICENSE-2.0
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+***************************************************************************/
+
+#include "stats.h"
+
+
+// integer division rounding half away from zero
+static int32_t stats_div(int32_t value, int32_t divisor) {
+    return (value + (value < 0 ? -divisor : divisor) / 2) / divisor;
+}
+
+
+// integer square root (rounded down)
+static uint32_t stats_sqrt(uint64_t value) {
+    uint64_t bit = 1ULL << 62, root = 0;
+
+    while (bit > value)
+        bit >>= 2;
+    while (bit != 0) {
+        if (value >= root + bit) {
+            value -= root + bit;
+            root = (root >> 1) + bit;
+        } else {
+            root >>= 1;
+        }
+        bit >>= 2;
+    }
+    return root;
+}
+
+
+void stats_reset(stats_t *stats) {
+    memset(stats, 0, sizeof(stats_t));
+}
+
+
+// add value, count saturates at 65535 samples
+void stats_add(stats_t *stats, int16_t value) {
+    if (stats->count == 0xFFFF)
+        return;
+    if (stats->count == 0 || value < stats->min)
+        stats->min = value;
+    if (stats->count == 0 || value > stats->max)
+        stats->max = value;
+    stats->count++;
+    stats->sum += value;
+    stats->sumsq += (int32_t)value * value;
+}
+
+
+// arithmetic mean (0 if no samples)
+int16_t stats_mean(const stats_t *stats) {
+    if (stats->count == 0)
+        return 0;
+    return stats_div(stats->sum, stats->count);
+}
+
+
+// mean without min. and max. value (mean if less than 3 samples)
+int16_t stats_trimmed(const stats_t *stats) {
+    if (stats->count < 3)
+        return stats_mean(stats);
+    return stats_div(stats->sum - stats->min - stats->max, stats->count - 2);
+}
+
+
+// sample standard deviation (0 if less than 2 samples)
+uint16_t stats_stddev(const stats_t *stats) {
+    uint64_t n = stats->count;
+    int64_t sum = stats->sum;
+
+    if (n < 2)
+        return 0;
+    // n * Σx² - (Σx)² >= 0, rounded to nearest integer
+    return stats_sqrt(((n * stats->sumsq - (uint64_t)(sum * sum)) + (n * (n - 1)) / 2) / (n * (n - 1)));
+}
+
+
+void stats_summary(const stats_t *stats, statsSummary_t *summary) {
+    summary->min = stats->min;
+    summary->max = stats->max;
+    summary->stddev = stats_stddev(stats);
+}
@@ -24,10 +24,18 @@
 #include "sensors.h"
 #include "rtc.h"
 
+#ifdef LOG_TOKENIZED
+// tokenized log record in preparation
+static uint8_t record[LOG_RECORD_MAX];
+static uint8_t recordLen = 0;
+static bool recordFull = false; // arguments dropped, last byte kept for CRC
+#elif defined(SERIAL_BAUD)
 // for log messages
 static char msg[MAX_MSG];
+#endif
 
 
+#ifdef LED_PATTERNS
 // blink system LED
 void blink_led(uint16_t pause, uint8_t blinks) {
 #ifdef LED_PIN
@@ -39,12 +47,77 @@ void blink_led(uint16_t pause, uint8_t blinks) {
     }
 #endif
 }
+#endif
+
+
+#ifdef LOG_TOKENIZED
+// append unsigned LEB128 varint to log record if it fits as a whole,
+// otherwise this and all following arguments are dropped (decoded as <?>)
+static void log_varint(uint64_t value) {
+    uint8_t len = 1;
+
+    for (uint64_t v = value >> 7; v; v >>= 7)
+        len++;
+    if (recordFull || recordLen + len > LOG_RECORD_MAX - 1) {
+        recordFull = true;
+        return;
+    }
+    do {
+        record[recordLen++] = (value & 0x7F) | (value > 0x7F ? 0x80 : 0);
+        value >>= 7;
+    } while (value);
+}
 
 
+// start tokenized log record with token and current
+// timestamp (ms) instead of formatting a log message
+void log_begin(uint32_t token) {
+    recordLen = 0;
+    recordFull = false;
+    record[recordLen++] = LOG_RECORD_SYNC;
+    record[recordLen++] = 0; // length, set by log_end()
+    for (uint8_t i = 0; i < 4; i++)
+        record[recordLen++] = token >> (i * 8);
+    log_varint(lmic_status == NONE ? millis() : osticks2ms(os_getTime()));
+}
+
+
+// append integer argument (zigzag encoded)
+void log_int(int64_t value) {
+    log_varint(((uint64_t)value << 1) ^ (uint64_t)(value >> 63));
+}
+
+
+// append string argument (length byte and characters),
+// shortened to the space left in log record
+void log_str(const char *s) {
+    uint8_t len = min(strlen(s), LOG_STRING_MAX);
+
+    if (recordFull || recordLen + 1 > LOG_RECORD_MAX - 1) {
+        recordFull = true;
+        return;
+    }
+    len = min(len, LOG_RECORD_MAX - 2 - recordLen);
+    record[recordLen++] = len;
+    memcpy(record + recordLen, s, len);
+    recordLen += len;
+}
+
+
+// complete log record and write it to serial port
+void log_end() {
+#ifdef SERIAL_BAUD
+    record[1] = recordLen - 2;
+    record[recordLen] = crc8(record + 1, recordLen - 1);
+    serial.write(record, recordLen + 1);
+#endif
+}
+#else
 // print log messages with current LMIC ticks and RTC timestamp (UTC) 
 // after LoRaWAN DeviceTimeReq was answered. Requires inited LMIC stack.
 void log_msg(const char *fmt, ...) {
 #ifdef SERIAL_BAUD
+    PROFILE(PROFILE_LOG_MSG);
     snprintf(msg, MAX_MSG, "[%02d:%02d:%02d|", rtc.getHours(), rtc.getMinutes(), rtc.getSeconds());
     serial.write(msg, strlen(msg));
     if (lmic_status == NONE)
@@ -60,6 +133,7 @@ void log_msg(const char *fmt, ...) {
     serial.println();
 #endif
 }
+#endif
 
 
 // turn hex byte array of given length into a null-terminated hex string
@@ -78,7 +152,30 @@ void print_hex(uint8_t *arr, uint8_t len, bool ln, bool reverse) {
         serial.println();
 }
 
-// https://forum.arduino.cc/t/map-to-floating-point/3976/3
-float mapfloat(float x, float in_min, float in_max, float out_min, float out_max) {
-    return (x - in_min) * (out_max - out_min) / (in_max - in_min) + out_min;
+// format fixed-point value with given number of decimals
+// (e.g. 2150 with 2 decimals -> "21.50"), buf needs 12 bytes
+char *fixstr(char *buf, int32_t value, uint8_t decimals) {
+    uint32_t scale = 1, mag = value < 0 ? -value : value;
+
+    for (uint8_t i = 0; i < decimals; i++)
+        scale *= 10;
+    if (decimals == 0)
+        sprintf(buf, "%ld", (long)value);
+    else
+        sprintf(buf, "%s%lu.%0*lu", value < 0 ? "-" : "", (unsigned long)(mag / scale),
+            decimals, (unsigned long)(mag % scale));
+    return buf;
+}
+
+
+// CRC-8 (polynomial 0x07) for data stored in flash
+uint8_t crc8(const uint8_t *buf, uint16_t len) {
+    uint8_t crc = 0;
+
+    while (len--) {
+        crc ^= *buf++;
+        for (uint8_t i = 0; i < 8; i++)
+            crc = (crc & 0x80) ? (crc << 1) ^ 0x07 : (crc << 1);
+    }
+    return crc;
 }
\ No newline at end of file
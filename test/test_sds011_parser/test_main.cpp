@@ -0,0 +1,211 @@
+/***************************************************************************
+  Copyright (c) 2024 Lars Wessels
+
+  This file is part of the "Feather-M0-LoRaWAN-PM-Sensor" source code.
+  https://github.com/lrswss/feather-m0-lorawan-pm-sensor
+
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+   
+  http://www.apache.org/licenses/LICENSE-2.0
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+***************************************************************************/
+
+// host test for SDS011Parser (pio test -e test_native): feeds random,
+// corrupted and valid byte streams and checks that only valid frames are
+// accepted, no bytes outside the parser are touched and the parser resyncs
+// after garbage; reports throughput of feed() in MB/s
+
+#include <unity.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "sds011_parser.h"
+
+#define RANDOM_BYTES (16UL * 1024 * 1024)
+#define STREAM_FRAMES 100000
+#define GARBAGE_MAX 24
+#define GUARD_LEN 16
+#define GUARD_BYTE 0x5A
+
+// parser placed between guard bytes to detect writes out of bounds
+static struct {
+    uint8_t before[GUARD_LEN];
+    SDS011Parser parser;
+    uint8_t after[GUARD_LEN];
+} guarded;
+
+static uint32_t seed = 1;
+
+
+// xorshift32, same sequence on all hosts
+static uint8_t random_byte() {
+    seed ^= seed << 13;
+    seed ^= seed >> 17;
+    seed ^= seed << 5;
+    return seed & 0xFF;
+}
+
+
+// reference check of a complete frame
+static bool frame_valid(const uint8_t *frame) {
+    uint8_t crc = 0;
+
+    for (uint8_t i = 2; i < 8; i++)
+        crc += frame[i];
+    return frame[0] == SDS011_FRAME_HEAD && frame[9] == SDS011_FRAME_TAIL && frame[8] == crc &&
+        (frame[1] == SDS011_REPLY_DATA || frame[1] == SDS011_REPLY_CMD);
+}
+
+
+static void frame_random(uint8_t *frame) {
+    frame[0] = SDS011_FRAME_HEAD;
+    frame[1] = (random_byte() & 1) ? SDS011_REPLY_DATA : SDS011_REPLY_CMD;
+    frame[8] = 0;
+    for (uint8_t i = 2; i < 8; i++) {
+        frame[i] = random_byte();
+        frame[8] += frame[i];
+    }
+    frame[9] = SDS011_FRAME_TAIL;
+}
+
+
+// feed byte, check frame returned (if any) and guard bytes
+static const SDS011Frame* feed_checked(uint8_t c) {
+    const SDS011Frame *frame = guarded.parser.feed(c);
+
+    if (frame != NULL) {
+        TEST_ASSERT_TRUE_MESSAGE((const uint8_t *)frame >= (const uint8_t *)&guarded.parser &&
+            (const uint8_t *)(frame + 1) <= (const uint8_t *)(&guarded.parser + 1),
+            "frame outside of parser");
+        TEST_ASSERT_TRUE_MESSAGE(frame_valid((const uint8_t *)frame), "invalid frame accepted");
+    }
+    return frame;
+}
+
+
+static void guards_check() {
+    for (uint8_t i = 0; i < GUARD_LEN; i++) {
+        TEST_ASSERT_EQUAL_HEX8(GUARD_BYTE, guarded.before[i]);
+        TEST_ASSERT_EQUAL_HEX8(GUARD_BYTE, guarded.after[i]);
+    }
+}
+
+
+void setUp() {
+    memset(guarded.before, GUARD_BYTE, GUARD_LEN);
+    memset(guarded.after, GUARD_BYTE, GUARD_LEN);
+    guarded.parser = SDS011Parser();
+    seed = 1;
+}
+
+
+void tearDown() {
+    guards_check();
+}
+
+
+// random bytes, every accepted frame must pass the reference check
+void test_random_bytes() {
+    uint32_t frames = 0;
+
+    for (uint32_t i = 0; i < RANDOM_BYTES; i++)
+        if (feed_checked(random_byte()) != NULL)
+            frames++;
+    TEST_ASSERT_EQUAL_UINT32(frames, guarded.parser.frames());
+}
+
+
+// valid frames separated by garbage and corrupted frames (one byte changed),
+// every valid frame must be received and no corrupted one
+void test_resync() {
+    uint8_t frame[SDS011_FRAME_LEN], corrupt[SDS011_FRAME_LEN], n, i;
+    const SDS011Frame *received;
+    uint32_t expected = 0, matched = 0;
+
+    for (uint32_t f = 0; f < STREAM_FRAMES; f++) {
+        for (n = random_byte() % GARBAGE_MAX; n > 0; n--)
+            feed_checked(random_byte());
+
+        if (random_byte() & 1) {
+            frame_random(corrupt);
+            corrupt[random_byte() % SDS011_FRAME_LEN] ^= (random_byte() | 0x01);
+            for (i = 0; i < SDS011_FRAME_LEN; i++)
+                feed_checked(corrupt[i]); // rejected by reference check if returned
+        }
+
+        frame_random(frame);
+        expected++;
+        for (i = 0; i < SDS011_FRAME_LEN; i++) {
+            received = feed_checked(frame[i]);
+            if (received != NULL && i == SDS011_FRAME_LEN - 1 &&
+                    memcmp(received, frame, SDS011_FRAME_LEN) == 0)
+                matched++;
+        }
+    }
+    TEST_ASSERT_EQUAL_UINT32(expected, matched);
+}
+
+
+// consecutive valid frames without garbage, none may be dropped
+void test_back_to_back() {
+    uint8_t frame[SDS011_FRAME_LEN];
+    const SDS011Frame *received;
+
+    for (uint32_t f = 0; f < STREAM_FRAMES; f++) {
+        frame_random(frame);
+        for (uint8_t i = 0; i < SDS011_FRAME_LEN - 1; i++)
+            TEST_ASSERT_NULL(feed_checked(frame[i]));
+        received = feed_checked(frame[SDS011_FRAME_LEN - 1]);
+        TEST_ASSERT_NOT_NULL(received);
+        TEST_ASSERT_EQUAL_MEMORY(frame, received, SDS011_FRAME_LEN);
+    }
+    TEST_ASSERT_EQUAL_UINT32(STREAM_FRAMES, guarded.parser.frames());
+    TEST_ASSERT_EQUAL_UINT32(0, guarded.parser.dropped());
+}
+
+
+// bytes per second of feed() with random bytes and with valid frames
+void test_throughput() {
+    static uint8_t stream[RANDOM_BYTES];
+    char msg[80];
+    struct timespec start, end;
+    double secs;
+    uint32_t i, frames = 0;
+
+    for (i = 0; i < RANDOM_BYTES / 2; i++)
+        stream[i] = random_byte();
+    for (; i + SDS011_FRAME_LEN <= RANDOM_BYTES; i += SDS011_FRAME_LEN)
+        frame_random(stream + i);
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (i = 0; i < RANDOM_BYTES; i++)
+        if (guarded.parser.feed(stream[i]) != NULL)
+            frames++;
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    secs = (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1e9;
+
+    TEST_ASSERT_GREATER_OR_EQUAL_UINT32(RANDOM_BYTES / 2 / SDS011_FRAME_LEN, frames);
+    snprintf(msg, sizeof(msg), "%.1f MB/s (%lu bytes, %lu frames, %lu dropped)",
+        RANDOM_BYTES / secs / 1e6, RANDOM_BYTES, (unsigned long)frames,
+        (unsigned long)guarded.parser.dropped());
+    TEST_MESSAGE(msg);
+}
+
+
+int main() {
+    UNITY_BEGIN();
+    RUN_TEST(test_random_bytes);
+    RUN_TEST(test_resync);
+    RUN_TEST(test_back_to_back);
+    RUN_TEST(test_throughput);
+    return UNITY_END();
+}
@@ -0,0 +1,191 @@
+#!/usr/bin/env python3
+#
+# Copyright (c) 2024 Lars Wessels
+#
+# This file is part of the "Feather-M0-LoRaWAN-PM-Sensor" source code.
+# https://github.com/lrswss/feather-m0-lorawan-pm-sensor
+#
+# Licensed under the Apache License, Version 2.0 (the "License");
+# you may not use this file except in compliance with the License.
+# You may obtain a copy of the License at
+#
+# http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing, software
+# distributed under the License is distributed on an "AS IS" BASIS,
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+# See the License for the specific language governing permissions and
+# limitations under the License.
+#
+# Decode tokenized log records written by firmware built with LOG_TOKENIZED
+# (see include/utils.h). The token table is built from all log_*() format
+# strings found in the firmware sources, so use the sources of the build.
+#
+# usage: tools/logdecode.py [--port /dev/ttyUSB0 [--baud 9600]] [file]
+#        tools/logdecode.py --table
+
+import argparse
+import os
+import re
+import sys
+
+LOG_RECORD_SYNC = 0xF5
+
+LOG_CALL = re.compile(r'\blog_(?:msg|error|warn|info|debug)\(\s*((?:"(?:[^"\\]|\\.)*"\s*)+)')
+LITERAL = re.compile(r'"((?:[^"\\]|\\.)*)"')
+FORMAT = re.compile(r'%([-+ #0]*)(\d*|\*)(?:\.(\d+))?(hh|h|ll|l)?([diuxXcs%])')
+ESCAPES = {'n': '\n', 't': '\t', 'r': '\r', '"': '"', '\\': '\\', "'": "'", '0': '\0'}
+
+
+# 32-bit FNV-1a hash as computed by log_token() in include/utils.h
+def fnv1a(data):
+    h = 2166136261
+    for b in data:
+        h = ((h ^ b) * 16777619) & 0xFFFFFFFF
+    return h
+
+
+def unescape(literal):
+    return re.sub(r'\\(.)', lambda m: ESCAPES.get(m.group(1), m.group(1)), literal)
+
+
+# map tokens to format strings of all log_*() calls in given directories
+def token_table(dirs):
+    table = {}
+    for d in dirs:
+        for root, _, files in os.walk(d):
+            for name in sorted(files):
+                if not name.endswith(('.cpp', '.c', '.h')):
+                    continue
+                path = os.path.join(root, name)
+                with open(path, encoding='utf-8') as f:
+                    source = f.read()
+                for call in LOG_CALL.finditer(source):
+                    fmt = ''.join(unescape(s) for s in LITERAL.findall(call.group(1)))
+                    token = fnv1a(fmt.encode('utf-8'))
+                    if token in table and table[token] != fmt:
+                        print('token collision 0x%08X: "%s" / "%s"' % (token, table[token], fmt),
+                            file=sys.stderr)
+                    table[token] = fmt
+    return table
+
+
+def crc8(data):
+    crc = 0
+    for b in data:
+        crc ^= b
+        for _ in range(8):
+            crc = ((crc << 1) ^ 0x07) & 0xFF if crc & 0x80 else (crc << 1) & 0xFF
+    return crc
+
+
+def varint(body, pos):
+    value, shift = 0, 0
+    while pos < len(body):
+        b = body[pos]
+        pos += 1
+        value |= (b & 0x7F) << shift
+        shift += 7
+        if not b & 0x80:
+            return value, pos
+    raise IndexError('truncated')
+
+
+# replace conversions in printf format string with decoded arguments
+def format_record(fmt, body, pos):
+    out, last = [], 0
+    for m in FORMAT.finditer(fmt):
+        flags, width, prec, _, conv = m.groups()
+        out.append(fmt[last:m.start()])
+        last = m.end()
+        if conv == '%':
+            out.append('%')
+            continue
+        try:
+            if conv == 's':
+                n = body[pos]
+                value = body[pos + 1:pos + 1 + n].decode('utf-8', 'replace')
+                pos += 1 + n
+            else:
+                value, pos = varint(body, pos)
+                value = (value >> 1) ^ -(value & 1)
+                if conv in 'uxX' and value < 0:
+                    value &= 0xFFFFFFFF
+                elif conv == 'c':
+                    value, conv = chr(value & 0xFF), 's'
+                elif conv == 'i':
+                    conv = 'd'
+        except IndexError:
+            out.append('<?>')
+            continue
+        spec = '%' + flags + width + ('.' + prec if prec else '') + conv
+        out.append(spec % value)
+    out.append(fmt[last:])
+    return ''.join(out)
+
+
+def decode(stream, table, out):
+    buf = bytearray()
+    while True:
+        chunk = stream.read(1)
+        if not chunk:
+            break
+        buf += chunk
+        while buf:
+            if buf[0] != LOG_RECORD_SYNC:
+                # plain serial output (e.g. sensor readings)
+                out.write(bytes([buf.pop(0)]).decode('latin-1'))
+                continue
+            if len(buf) < 2 or len(buf) < buf[1] + 3:
+                break
+            length = buf[1]
+            body = bytes(buf[2:2 + length])
+            if length < 5 or crc8(buf[1:2 + length]) != buf[2 + length]:
+                out.write(chr(buf.pop(0)))
+                continue
+            del buf[:3 + length]
+            token = int.from_bytes(body[0:4], 'little')
+            try:
+                ts, pos = varint(body, 4)
+            except IndexError:
+                ts, pos = 0, len(body)
+            if token in table:
+                msg = format_record(table[token], body, pos)
+            else:
+                msg = 'unknown token 0x%08X %s' % (token, body[pos:].hex())
+            out.write('[%08d] %s\n' % (ts, msg))
+        out.flush()
+
+
+def main():
+    repo = os.path.dirname(os.path.dirname(os.path.abspath(__file__)))
+    parser = argparse.ArgumentParser(description='Decode tokenized firmware log records')
+    parser.add_argument('file', nargs='?', help='captured serial output (default: stdin)')
+    parser.add_argument('--port', help='read from serial port (requires pyserial)')
+    parser.add_argument('--baud', type=int, default=9600)
+    parser.add_argument('--src', action='append',
+        help='firmware source directory (default: src and include)')
+    parser.add_argument('--table', action='store_true', help='print token table and exit')
+    args = parser.parse_args()
+
+    table = token_table(args.src or [os.path.join(repo, 'src'), os.path.join(repo, 'include')])
+    if args.table:
+        for token, fmt in sorted(table.items(), key=lambda t: t[1]):
+            print('0x%08X %s' % (token, fmt))
+        return
+
+    if args.port:
+        import serial
+        stream = serial.Serial(args.port, args.baud)
+    elif args.file:
+        stream = open(args.file, 'rb')
+    else:
+        stream = sys.stdin.buffer
+    try:
+        decode(stream, table, sys.stdout)
+    except KeyboardInterrupt:
+        pass
+
+
+if __name__ == '__main__':
+    main()